@@ -0,0 +1,120 @@
+#ifndef JSON_03_ATOMIC
+#define JSON_03_ATOMIC
+
+#include "JSONConfig.h"
+
+#if defined(__GNUC__)
+#elif defined(_MSC_VER)
+//The intrinsics themselves, rather than <windows.h>, whose min and max macros would break std::min and std::max for anyone
+//including this
+#include <intrin.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(JSON_03_CXX11)
+#include <atomic>
+#else
+#error No atomic operations are known for this platform
+#endif
+
+/*
+*  The two atomic operations we need for sharing data between threads: a reference count, and a pointer which is set once
+*  and then read many times without a lock. C++03 has no atomics of its own, so we use the compiler intrinsics which every
+*  platform we target provides; these are preferred even on later standards so that the layout of these classes doesn't
+*  change depending on which standard a particular file is compiled to.
+*/
+
+
+class JSONAtomicCount {
+public:
+	explicit JSONAtomicCount(long initial) : m_count(initial) {}
+
+	void increment() {
+#if defined(__GNUC__)
+		__atomic_fetch_add(&m_count, 1, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER)
+		_InterlockedIncrement(&m_count);
+#elif defined(_WIN32)
+		InterlockedIncrement(&m_count);
+#else
+		m_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+	}
+
+	//Returns the new count, so the caller knows when it has released the last reference
+	long decrement() {
+#if defined(__GNUC__)
+		return __atomic_sub_fetch(&m_count, 1, __ATOMIC_ACQ_REL);
+#elif defined(_MSC_VER)
+		return _InterlockedDecrement(&m_count);
+#elif defined(_WIN32)
+		return InterlockedDecrement(&m_count);
+#else
+		return m_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+#endif
+	}
+
+private:
+#if defined(__GNUC__) || defined(_WIN32)
+	volatile long m_count;
+#else
+	std::atomic<long> m_count;
+#endif
+
+	JSONAtomicCount(const JSONAtomicCount&);
+	JSONAtomicCount& operator=(const JSONAtomicCount&);
+};
+
+
+
+//A pointer which starts off null and is published at most once. Whoever loses a race to publish is told so, and should
+//discard their own copy in favour of the winner's.
+template<typename T>
+class JSONAtomicPointer {
+public:
+	JSONAtomicPointer() : m_ptr(0) {}
+
+	T* load() const {
+#if defined(__GNUC__)
+		return __atomic_load_n(&m_ptr, __ATOMIC_ACQUIRE);
+#elif defined(_WIN32)
+		//Volatile reads have acquire semantics with MSVC and C++Builder on Windows
+		return m_ptr;
+#else
+		return m_ptr.load(std::memory_order_acquire);
+#endif
+	}
+
+	bool publish(T* desired) {
+#if defined(__GNUC__)
+		T* expected = 0;
+		return __atomic_compare_exchange_n(&m_ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+		return _InterlockedCompareExchangePointer(reinterpret_cast<void* volatile*>(&m_ptr),
+			const_cast<void*>(static_cast<const void*>(desired)), 0) == 0;
+#elif defined(_WIN32)
+		return InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&m_ptr),
+			const_cast<void*>(static_cast<const void*>(desired)), 0) == 0;
+#else
+		T* expected = 0;
+		return m_ptr.compare_exchange_strong(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+#endif
+	}
+
+private:
+#if defined(__GNUC__) || defined(_WIN32)
+	T* volatile m_ptr;
+#else
+	std::atomic<T*> m_ptr;
+#endif
+
+	JSONAtomicPointer(const JSONAtomicPointer&);
+	JSONAtomicPointer& operator=(const JSONAtomicPointer&);
+};
+
+#endif
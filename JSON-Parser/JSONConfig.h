@@ -0,0 +1,30 @@
+#ifndef JSON_03_CONFIG
+#define JSON_03_CONFIG
+
+/*
+*  The core of this code is written to C++03, but a handful of features (threads, futures and the like) only make sense with a
+*  later standard library. Those are conditionally included on the macro below, in the same way as the C++Builder string types.
+*  MSVC only reports the standard it is compiling to in _MSVC_LANG, unless /Zc:__cplusplus is set.
+*/
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+#define JSON_03_CXX11
+#endif
+
+//Storage which each thread has its own copy of. Before C++11 this is a compiler extension; where none is known, whatever
+//uses it is left out.
+#if defined(JSON_03_CXX11)
+#define JSON_03_THREAD_LOCAL thread_local
+#elif defined(__GNUC__)
+#define JSON_03_THREAD_LOCAL __thread
+#elif defined(_MSC_VER) || defined(__BORLANDC__)
+#define JSON_03_THREAD_LOCAL __declspec(thread)
+#endif
+
+//The type integers in the JSON are decoded to. C++03 has no long long, so there it is as wide as long is on the platform.
+#ifdef JSON_03_CXX11
+typedef long long json_int;
+#else
+typedef long json_int;
+#endif
+
+#endif
@@ -3,20 +3,374 @@
 #pragma hdrstop
 
 #include <vector>
+#include <map>
+#include <sstream>
+#include <cstring>
 
 #include "JSONEntry.h"
+#include "JSONNodeTable.h"
 
 //---------------------------------------------------------------------------
 #pragma package(smart_init)
 
+namespace {
+
+	typedef std::pair<std::size_t, std::size_t> Span;
+
+	//Reads a value back one character at a time in a canonical form, so that any two values we consider equal read back the
+	//same: whitespace outside of strings is skipped, and a value which is a single string reads as its decoded contents.
+	//Whether it was a string is kept apart, so that "1" and 1 read the same but are never taken for the same value.
+	class CanonicalReader {
+	public:
+		CanonicalReader(const std::string& data, Span value)
+			: m_pos(data.data() + value.first), m_end(data.data() + value.second), m_structural(true), m_inString(false),
+			m_escaped(false) {
+			if(value.second - value.first >= 2 && data[value.first] == '\"' && findEndOfString(data, value.first) == value.second - 1){
+				m_structural = false;
+				++m_pos;
+				--m_end;
+				//Only strings with escapes in need decoding, which is the only time we need to allocate
+				if(std::find(m_pos, m_end, '\\') != m_end){
+					appendUnescaped(m_decoded, m_pos, m_end - m_pos);
+					m_pos = m_decoded.data();
+					m_end = m_pos + m_decoded.length();
+				}
+			}
+		}
+
+		bool isString() const{
+			return !m_structural;
+		}
+
+		bool next(char& c){
+			while(m_pos != m_end){
+				c = *m_pos++;
+				if(!m_structural) return true;
+				if(m_inString){
+					if(m_escaped) m_escaped = false;
+					else if(c == '\\') m_escaped = true;
+					else if(c == '\"') m_inString = false;
+					return true;
+				}
+				if(c == '\"') m_inString = true;
+				else if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\b') continue;
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		const char* m_pos;
+		const char* m_end;
+		bool        m_structural;
+		bool        m_inString;
+		bool        m_escaped;
+		std::string m_decoded;
+
+		CanonicalReader(const CanonicalReader&);
+		CanonicalReader& operator=(const CanonicalReader&);
+	};
+
+	bool canonicalEqual(const std::string& lhsData, Span lhsValue, const std::string& rhsData, Span rhsValue){
+		CanonicalReader lhs(lhsData, lhsValue);
+		CanonicalReader rhs(rhsData, rhsValue);
+		//A string is never equal to anything else, whatever it holds
+		if(lhs.isString() != rhs.isString()) return false;
+		char lhsChar = 0;
+		char rhsChar = 0;
+		for(;;){
+			bool lhsMore = lhs.next(lhsChar);
+			bool rhsMore = rhs.next(rhsChar);
+			if(lhsMore != rhsMore) return false;
+			if(!lhsMore) return true;
+			if(lhsChar != rhsChar) return false;
+		}
+	}
+
+
+
+#ifdef JSON_03_THREAD_LOCAL
+	//Where a key was last found by operator[], for trying first the next time. Predictions are found by the address of the
+	//key, and keys which land in the same place simply replace each other.
+	struct MemberPrediction {
+		const char*          key;
+		const JSONNodeTable* table;
+		std::size_t          shape;
+		std::size_t          slot;
+		std::size_t          keyID;
+	};
+	const std::size_t predictionCount = 64;
+	JSON_03_THREAD_LOCAL MemberPrediction predictions[predictionCount];
+	JSON_03_THREAD_LOCAL unsigned long predictionHits;
+	JSON_03_THREAD_LOCAL unsigned long predictionMisses;
+#endif
+
+
+
+	Span trimSpan(const std::string& data, Span span){
+		while(span.first < span.second && std::strchr(" \t\r\n\b,", data[span.first]) && data[span.first] != '\0') ++span.first;
+		while(span.second > span.first && std::strchr(" \t\r\n\b,", data[span.second - 1]) && data[span.second - 1] != '\0') --span.second;
+		return span;
+	}
+
+	std::string childPath(const std::string& path, const std::string& child){
+		return path.empty() ? child : path + '/' + child;
+	}
+
+	//As findEndOfTerm, but stopping at the end of the given span, so that a term which runs to the end is told apart from
+	//one which ends in a comma
+	std::size_t endOfTerm(const std::string& data, std::size_t termStart, std::size_t last){
+		std::size_t braceCount = 0;
+		for(std::size_t i = termStart; i < last; ++i){
+			if(data[i] == '\"') i = findEndOfString(data, i);
+			else if(data[i] == '{' || data[i] == '[') ++braceCount;
+			else if((data[i] == '}' || data[i] == ']') && braceCount > 0) --braceCount;
+			else if(braceCount == 0 && data[i] == ',') return i;
+		}
+		return last;
+	}
+
+	//The top level terms within the body of an object or array, i.e. its members or its elements
+	std::vector<Span> splitTerms(const std::string& data, Span body){
+		std::vector<Span> terms;
+		for(std::size_t termStart = body.first; termStart < body.second;){
+			std::size_t termEnd = endOfTerm(data, termStart, body.second);
+			Span term = trimSpan(data, Span(termStart, termEnd));
+			if(term.first < term.second) terms.push_back(term);
+			termStart = termEnd + 1;
+		}
+		return terms;
+	}
+
+	//Split an object member, e.g. "Name" : "John", into its decoded key and the span of its value
+	bool splitMember(const std::string& data, Span term, std::string& key, Span& value){
+		if(term.first >= term.second || data[term.first] != '\"') return false;
+		std::size_t keyEnd = findEndOfString(data, term.first);
+		std::size_t colon = data.find_first_not_of(" \t\r\n\b", keyEnd + 1);
+		if(keyEnd >= term.second || colon >= term.second || data[colon] != ':') return false;
+
+		key.clear();
+		appendUnescaped(key, data.data() + term.first + 1, keyEnd - term.first - 1);
+		value = trimSpan(data, Span(colon + 1, term.second));
+		return true;
+	}
+
+	//Whether an entry's data starts with an object member, e.g. "Name":"John", rather than a bare value
+	bool startsWithMember(const std::string& data, Span span){
+		std::string key;
+		Span value;
+		return splitMember(data, Span(span.first, endOfTerm(data, span.first, span.second)), key, value);
+	}
+
+	//The first of the terms within the body of an object which is a member with the given (unescaped) key
+	bool findMemberTerm(const std::string& data, Span body, const std::string& key, Span& found){
+		std::vector<Span> terms = splitTerms(data, body);
+		std::string name;
+		Span value;
+		for(std::size_t i = 0; i < terms.size(); ++i){
+			if(splitMember(data, terms[i], name, value) && name == key){
+				found = terms[i];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//The value an entry holds: for a single member, e.g. "Name":"John", the value after its key, and otherwise the whole
+	//entry - a bare value, or the members of an object without its braces
+	Span entryValue(const std::string& data){
+		Span span = trimSpan(data, Span(0, data.length()));
+		std::string key;
+		Span value;
+		if(span.first < span.second && endOfTerm(data, span.first, span.second) == span.second && splitMember(data, span, key, value)){
+			return value;
+		}
+		return span;
+	}
+
+	//The hash JSONNodeTable::hash() gives a value, worked out from its text in a single pass. The objects and arrays which are
+	//open are kept on a stack, each with its hash so far and, for objects, the key of the member being read.
+	struct OpenValue {
+		std::size_t hash;
+		bool        object;
+		Span        key;
+	};
+
+	//A value which is finished goes into the object or array it is in, or is the result if it is in neither
+	void addValue(std::vector<OpenValue>& open, const std::string& data, std::size_t hash, std::size_t& result){
+		if(open.empty()){
+			result = hash;
+			return;
+		}
+		OpenValue& parent = open.back();
+		if(parent.object) hash = JSONNodeTable::memberHash(data.data() + parent.key.first, parent.key.second - parent.key.first, hash);
+		parent.hash = JSONNodeTable::addHash(parent.hash, hash);
+	}
+
+	std::size_t structuralHash(const std::string& data, Span span){
+		std::vector<OpenValue> open;
+		std::size_t result = 0;
+		//Members which aren't inside braces are hashed as an object of them
+		bool expectKey = span.first == span.second || startsWithMember(data, span);
+		if(expectKey){
+			OpenValue members = { JSONNodeTable::containerHash(JSONNodeTable::ObjectNode), true, Span(0, 0) };
+			open.push_back(members);
+		}
+
+		for(std::size_t i = span.first; i < span.second;){
+			char c = data[i];
+			if(c == '{' || c == '['){
+				expectKey = c == '{';
+				OpenValue opened = { JSONNodeTable::containerHash(expectKey ? JSONNodeTable::ObjectNode : JSONNodeTable::ArrayNode),
+					expectKey, Span(0, 0) };
+				open.push_back(opened);
+				++i;
+			}
+			else if(c == '}' || c == ']'){
+				if(!open.empty()){
+					std::size_t hash = open.back().hash;
+					open.pop_back();
+					addValue(open, data, hash, result);
+				}
+				++i;
+			}
+			else if(c == ',' || c == ':' || c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\b'){
+				if(c == ',') expectKey = !open.empty() && open.back().object;
+				++i;
+			}
+			else{
+				std::size_t end = (c == '\"') ? findEndOfString(data, i) + 1 : data.find_first_of(" \t\r\n\b,:}]", i);
+				end = std::min(end, span.second);
+				if(c == '\"' && expectKey){
+					open.back().key = Span(i + 1, end - 1);
+					expectKey = false;
+				}
+				else addValue(open, data, JSONNodeTable::scalarHash(data.data() + i, end - i), result);
+				i = end;
+			}
+		}
+
+		//Anything left open, such as members without braces, is closed at the end
+		while(!open.empty()){
+			std::size_t hash = open.back().hash;
+			open.pop_back();
+			addValue(open, data, hash, result);
+		}
+		return result;
+	}
+
+	typedef std::pair<std::string, std::size_t> DiffMember;
+
+	//Nodes which follow each other, along with their keys decoded
+	void appendMembers(const JSONNodeTable& table, std::size_t first, std::size_t count, std::vector<DiffMember>& members){
+		for(std::size_t i = first; i < first + count; ++i){
+			const std::string& name = table.keyName(table.node(i).key);
+			members.push_back(DiffMember(std::string(), i));
+			appendUnescaped(members.back().first, name.data(), name.length());
+		}
+	}
+
+	//The members of the node an entry refers to: itself if it is a member, and its members if it is an object without a key.
+	//Anything else isn't made of members.
+	bool membersOf(const JSONNodeTable& table, std::size_t index, std::vector<DiffMember>& members){
+		JSONNodeTable::Node node = table.node(index);
+		if(node.key != JSONNodeTable::none) appendMembers(table, index, 1, members);
+		else if(node.type == JSONNodeTable::ObjectNode) appendMembers(table, node.children, node.childCount, members);
+		else return false;
+		return true;
+	}
+
+	//The node holding the value an entry refers to, which for an object of one member without a key is that member, as the
+	//text of such an entry reads the same as the member does. This is the node JSONNodeTable::hash() hashes.
+	std::size_t valueNode(const JSONNodeTable& table, std::size_t index){
+		JSONNodeTable::Node node = table.node(index);
+		if(node.key == JSONNodeTable::none && node.type == JSONNodeTable::ObjectNode && node.childCount == 1) return node.children;
+		return index;
+	}
+
+	bool sameKeyOrder(const std::vector<DiffMember>& lhs, const std::vector<DiffMember>& rhs){
+		if(lhs.size() != rhs.size()) return false;
+		for(std::size_t i = 0; i < lhs.size(); ++i) if(lhs[i].first != rhs[i].first) return false;
+		return true;
+	}
+
+	void diffNodes(const JSONNodeTable& before, std::size_t beforeNode, const JSONNodeTable& after, std::size_t afterNode,
+		const std::string& path, std::vector<std::string>& changes);
+
+	void diffMembers(const JSONNodeTable& before, const std::vector<DiffMember>& beforeMembers, const JSONNodeTable& after,
+		const std::vector<DiffMember>& afterMembers, const std::string& path, std::vector<std::string>& changes){
+		std::map<std::string, std::size_t> unmatched;
+		for(std::size_t i = 0; i < afterMembers.size(); ++i) unmatched.insert(afterMembers[i]);
+
+		//Members which were changed or removed are found in the order they were in before, and what is left over was added
+		for(std::size_t i = 0; i < beforeMembers.size(); ++i){
+			std::map<std::string, std::size_t>::iterator match = unmatched.find(beforeMembers[i].first);
+			if(match == unmatched.end()) changes.push_back(childPath(path, beforeMembers[i].first));
+			else{
+				diffNodes(before, beforeMembers[i].second, after, match->second, childPath(path, match->first), changes);
+				unmatched.erase(match);
+			}
+		}
+		for(std::map<std::string, std::size_t>::const_iterator it = unmatched.begin(); it != unmatched.end(); ++it){
+			changes.push_back(childPath(path, it->first));
+		}
+	}
+
+	void diffNodes(const JSONNodeTable& before, std::size_t beforeNode, const JSONNodeTable& after, std::size_t afterNode,
+		const std::string& path, std::vector<std::string>& changes){
+		//Objects and arrays whose hashes differ are told apart straight away, and only those with the same hash are looked at
+		//in full, which ends the search below them, so nothing is compared more than once however deep the changes are
+		if(JSONNodeTable::equal(before, beforeNode, after, afterNode)) return;
+
+		//Two objects or two arrays are compared member by member, so that only the parts which changed are reported
+		std::size_t changesBefore = changes.size();
+		JSONNodeTable::Node lhs = before.node(beforeNode);
+		JSONNodeTable::Node rhs = after.node(afterNode);
+		if(lhs.type == JSONNodeTable::ObjectNode && rhs.type == JSONNodeTable::ObjectNode){
+			std::vector<DiffMember> beforeMembers;
+			std::vector<DiffMember> afterMembers;
+			appendMembers(before, lhs.children, lhs.childCount, beforeMembers);
+			appendMembers(after, rhs.children, rhs.childCount, afterMembers);
+			diffMembers(before, beforeMembers, after, afterMembers, path, changes);
+		}
+		else if(lhs.type == JSONNodeTable::ArrayNode && rhs.type == JSONNodeTable::ArrayNode){
+			for(std::size_t i = 0; i < std::max(lhs.childCount, rhs.childCount); ++i){
+				std::ostringstream index;
+				index << i;
+				if(i >= lhs.childCount || i >= rhs.childCount) changes.push_back(childPath(path, index.str()));
+				else diffNodes(before, lhs.children + i, after, rhs.children + i, childPath(path, index.str()), changes);
+			}
+		}
+		if(changes.size() == changesBefore) changes.push_back(path);
+	}
+
+	//Tables parsed from the text of entries for the length of a diff
+	struct ParsedTables {
+		JSONNodeTable* tables[2];
+
+		ParsedTables(){
+			tables[0] = 0;
+			tables[1] = 0;
+		}
+		~ParsedTables(){
+			delete tables[0];
+			delete tables[1];
+		}
+	};
+
+}
+
 //Our primary lookup will be via string, since the underlying data structure is all in terms of strings.
 //However as a single entry may contain an array with its own subentries, we also need to be able to parse and generate them
 //Here, all we need are top level commas, i.e. commas that are not inside a block of {.....}
 const JSONEntry JSONEntry::operator[](std::size_t index) const{
+	if(m_table) return nodeChild(index);
+
 	std::size_t braceDepth = 0;
 	std::vector<std::size_t> commaPos;
 	for(std::size_t i = 0; i < m_data.length();++i){
-		if(m_data[i] == '{') ++braceDepth;
+		if(m_data[i] == '\"') i = findEndOfString(m_data, i);
+		else if(m_data[i] == '{') ++braceDepth;
 		else if(m_data[i] == '}') --braceDepth;
 		else if(braceDepth == 0 && m_data[i] == ',') commaPos.push_back(i);
 	}
@@ -71,6 +425,8 @@ const JSONEntry JSONEntry::operator [](int index) const{
 
 const JSONEntry JSONEntry::operator [](const std::string& index) const {
 	if (index.length() > 1020) return JSONEntry(false);
+	//The copy below is at the same address whatever the key, so it isn't worth predicting where it will be found
+	if (m_table) return nodeMember(index.c_str());
 	char newIndex[1024];
 
 	//Warning suppression for MSVC. Since this is a C++03 project, we don't have many good alternatives to generate a char array
@@ -105,6 +461,17 @@ std::string trim(const std::string& toTrim, const char* charsToTrim){
 	return trim(copy, charsToTrim);
 }
 
+std::string& unwrapElement(std::string& element){
+	trim(element, " \t\r\n\b,");
+	//Only the one pair of braces, as trimming them all would take any nested ones with them
+	if(element.length() > 1 && element[0] == '{' && element[element.length() - 1] == '}'){
+		element.erase(element.length() - 1);
+		element.erase(0, 1);
+		trim(element, " \t\r\n\b");
+	}
+	return element;
+}
+
 bool operator==(const JSONEntry& lhs, const JSONEntry& rhs){
 	if(&lhs == &rhs) return true;
 
@@ -112,13 +479,29 @@ bool operator==(const JSONEntry& lhs, const JSONEntry& rhs){
 	if(!lhs && !rhs) return true;
 	else if(!lhs || !rhs) return false;
 
-	return lhs.as<std::string>() == rhs.as<std::string>();
+	//Different hashes settle it without looking at the data, but only if both are known already, i.e. the entries are in a
+	//table or have been hashed before. Working them out would be a scan of the data just to save another scan of it.
+	bool lhsHashed = lhs.m_table || lhs.m_hashed;
+	bool rhsHashed = rhs.m_table || rhs.m_hashed;
+	if(lhsHashed && rhsHashed && lhs.hash() != rhs.hash()) return false;
+
+	//Otherwise we look at the values themselves: node by node if they are both in tables, which passes over objects and
+	//arrays whose hashes differ, and as text, with no copies made, if not
+	if(lhs.m_table && rhs.m_table){
+		return JSONNodeTable::equal(*lhs.m_table, valueNode(*lhs.m_table, lhs.m_node), *rhs.m_table, valueNode(*rhs.m_table, rhs.m_node));
+	}
+	const std::string& lhsData = lhs.text();
+	const std::string& rhsData = rhs.text();
+	return canonicalEqual(lhsData, entryValue(lhsData), rhsData, entryValue(rhsData));
 }
 
 bool operator!=(const JSONEntry& lhs, const JSONEntry& rhs){
 	return !(lhs == rhs);
 }
 
+JSONEntry::JSONEntry(const JSONNodeTable* table, std::size_t node)
+	: m_valid(true), m_table(table), m_node(node), m_hash(0), m_hashed(false) {}
+
 bool JSONEntry::valid() const{
     return m_valid;
 }
@@ -127,14 +510,347 @@ bool JSONEntry::operator!() const{
     return !this->valid();
 }
 
+namespace {
+
+	JSONEntry::ValueType scalarType(const JSONNodeTable::Scalar& scalar){
+		switch(scalar.type){
+		case JSONNodeTable::NullScalar:    return JSONEntry::NullValue;
+		case JSONNodeTable::BoolScalar:    return JSONEntry::BoolValue;
+		case JSONNodeTable::IntegerScalar: return JSONEntry::IntegerValue;
+		case JSONNodeTable::DoubleScalar:  return JSONEntry::DoubleValue;
+		case JSONNodeTable::StringScalar:  return JSONEntry::StringValue;
+		default:                           return JSONEntry::InvalidValue;
+		}
+	}
+
+}
+
+JSONEntry::ValueType JSONEntry::type() const{
+	if(!m_valid) return InvalidValue;
+
+	if(m_table){
+		const JSONNodeTable::Node& node = m_table->node(m_node);
+		if(node.type == JSONNodeTable::ObjectNode) return ObjectValue;
+		if(node.type == JSONNodeTable::ArrayNode) return ArrayValue;
+		const JSONNodeTable::Scalar* decoded = m_table->scalar(m_node);
+		if(decoded) return scalarType(*decoded);
+		return scalarType(JSONNodeTable::decode(m_table->values().data() + node.begin, node.end - node.begin));
+	}
+
+	//More than one term can only be the members of an object
+	static const char* const whitespace = " \t\r\n\b";
+	std::size_t start = m_data.find_first_not_of(whitespace);
+	if(start == std::string::npos) return InvalidValue;
+	std::size_t end = endOfTerm(m_data, start, m_data.length());
+	if(m_data.find_first_not_of(" \t\r\n\b,", end) != std::string::npos) return ObjectValue;
+
+	//Otherwise the value follows the key, if there is one
+	if(m_data[start] == '\"'){
+		std::size_t afterKey = m_data.find_first_not_of(whitespace, findEndOfString(m_data, start) + 1);
+		if(afterKey < end && m_data[afterKey] == ':') start = m_data.find_first_not_of(whitespace, afterKey + 1);
+	}
+	if(start >= end) return InvalidValue;
+	if(m_data[start] == '{') return ObjectValue;
+	if(m_data[start] == '[') return ArrayValue;
+
+	while(end > start && std::strchr(" \t\r\n\b,", m_data[end - 1]) && m_data[end - 1] != '\0') --end;
+	return scalarType(JSONNodeTable::decode(m_data.c_str() + start, end - start));
+}
+
+bool JSONEntry::isNull() const{
+	return type() == NullValue;
+}
+
+bool JSONEntry::isBool() const{
+	return type() == BoolValue;
+}
+
+bool JSONEntry::isNumber() const{
+	ValueType valueType = type();
+	return valueType == IntegerValue || valueType == DoubleValue;
+}
+
+bool JSONEntry::isInteger() const{
+	return type() == IntegerValue;
+}
+
+bool JSONEntry::isString() const{
+	return type() == StringValue;
+}
+
+bool JSONEntry::isArray() const{
+	return type() == ArrayValue;
+}
+
+bool JSONEntry::isObject() const{
+	return type() == ObjectValue;
+}
+
+std::size_t JSONEntry::hash() const{
+	if(!m_valid) return 0;
+	//Tables hash their objects and arrays as they are parsed, so only text needs to be hashed here
+	if(m_table) return m_table->hash(m_node);
+	if(!m_hashed){
+		m_hash = structuralHash(m_data, entryValue(m_data));
+		m_hashed = true;
+	}
+	return m_hash;
+}
+
+std::pair<std::size_t, std::size_t> JSONEntry::valueSpan() const{
+	//The value runs from the first colon to the end of the term, or is the whole entry if there is no key
+	static const char* const punctuation = " \t\r\n\b,{}[]:";
+	const std::string& data = text();
+	std::size_t first = 0;
+	std::size_t last = data.length();
+	std::size_t colonPos = data.find(':');
+	if(colonPos != std::string::npos){
+		first = colonPos;
+		last = std::min(findEndOfTerm(data, colonPos) + 1, data.length());
+	}
+
+	first = std::min(data.find_first_not_of(punctuation, first), last);
+	while(last > first && std::strchr(punctuation, data[last - 1]) && data[last - 1] != '\0') --last;
+	return std::make_pair(first, last);
+}
+
+const std::string& JSONEntry::text() const{
+	if(m_table && m_data.empty()) m_data = m_table->text(m_node);
+	return m_data;
+}
+
+const JSONEntry JSONEntry::nodeChild(std::size_t index) const{
+	//As with text, a simple value is its own first and only element
+	if(m_table->node(m_node).type == JSONNodeTable::ScalarNode) return index == 0 ? *this : JSONEntry(false);
+
+	std::size_t found = m_table->child(m_node, index);
+	if(found == JSONNodeTable::npos) return JSONEntry(false);
+	return JSONEntry(m_table, found);
+}
+
+const JSONEntry JSONEntry::nodeMember(const char* key) const{
+	//Keys are looked up as they appear in the JSON, so escaped, unless the user has entered the quote marks themselves
+	std::size_t length = std::char_traits<char>::length(key);
+	std::string escaped;
+	if(length > 1 && key[0] == '\"' && key[length - 1] == '\"'){
+		++key;
+		length -= 2;
+	}
+	else if(findCharToEscape(key, length) != length){
+		escaped = escapeString(std::string(key, length));
+		key = escaped.data();
+		length = escaped.length();
+	}
+
+	std::size_t found = JSONNodeTable::npos;
+	const JSONNodeTable::Node& node = m_table->node(m_node);
+	if(node.type == JSONNodeTable::ObjectNode) found = m_table->member(m_node, key, length);
+	//As with text, an array gives us the first of its items with a matching key
+	else if(node.type == JSONNodeTable::ArrayNode){
+		for(std::size_t i = 0; i < node.childCount && found == JSONNodeTable::npos; ++i){
+			found = m_table->member(m_table->child(m_node, i), key, length);
+		}
+	}
+
+	if(found == JSONNodeTable::npos) return JSONEntry(false);
+	return JSONEntry(m_table, found);
+}
+
+const JSONEntry JSONEntry::predictedNodeMember(const char* key, std::size_t size) const{
+#ifdef JSON_03_THREAD_LOCAL
+	const JSONNodeTable::Node& node = m_table->node(m_node);
+	if(node.type != JSONNodeTable::ObjectNode) return nodeMember(key);
+
+	MemberPrediction& prediction = predictions[(reinterpret_cast<std::size_t>(key) / sizeof(void*)) % predictionCount];
+	if(prediction.key == key && prediction.table == m_table && prediction.shape == node.shape){
+		//The key's array may since hold another key, or the table may have been replaced by another at the same address, so
+		//the prediction is only taken if the member there really has this key
+		std::size_t found = m_table->child(m_node, prediction.slot);
+		if(found != JSONNodeTable::npos && m_table->node(found).key == prediction.keyID){
+			const std::string& name = m_table->keyName(prediction.keyID);
+			if(name.length() < size && key[name.length()] == '\0' && std::memcmp(name.data(), key, name.length()) == 0){
+				++predictionHits;
+				return JSONEntry(m_table, found);
+			}
+		}
+	}
+
+	++predictionMisses;
+	JSONEntry found = nodeMember(key);
+	if(found.m_valid){
+		prediction.key = key;
+		prediction.table = m_table;
+		prediction.shape = node.shape;
+		prediction.keyID = m_table->node(found.m_node).key;
+		prediction.slot = m_table->slot(node.shape, prediction.keyID);
+	}
+	return found;
+#else
+	(void)size;
+	return nodeMember(key);
+#endif
+}
+
+JSONEntry::LookupStats JSONEntry::lookupStats(){
+	LookupStats stats;
+#ifdef JSON_03_THREAD_LOCAL
+	stats.hits = predictionHits;
+	stats.misses = predictionMisses;
+#else
+	stats.hits = 0;
+	stats.misses = 0;
+#endif
+	return stats;
+}
+
+void JSONEntry::resetLookupStats(){
+#ifdef JSON_03_THREAD_LOCAL
+	predictionHits = 0;
+	predictionMisses = 0;
+#endif
+}
+
+bool JSONEntry::nodeScalar(std::string& out) const{
+	const JSONNodeTable::Node& node = m_table->node(m_node);
+	if(node.type != JSONNodeTable::ScalarNode) return false;
+	out.assign(m_table->values(), node.begin, node.end - node.begin);
+	return true;
+}
+
+void JSONEntry::elements(std::vector<JSONEntry>& out) const{
+	if(!m_valid) return;
+	if(m_table){
+		if(m_table->node(m_node).type == JSONNodeTable::ScalarNode) return;
+		for(std::size_t i = 0; i < m_table->node(m_node).childCount; ++i) out.push_back(JSONEntry(m_table, m_table->child(m_node, i)));
+		return;
+	}
+
+	//The body is that of the value if it is an object or array. Otherwise several terms are the members of an object.
+	Span body = trimSpan(m_data, Span(0, m_data.length()));
+	if(body.first == body.second) return;
+	bool members = endOfTerm(m_data, body.first, body.second) != body.second;
+	if(!members){
+		if(startsWithMember(m_data, body)){
+			std::size_t colon = m_data.find(':', findEndOfString(m_data, body.first));
+			body.first = m_data.find_first_not_of(" \t\r\n\b", colon + 1);
+			if(body.first >= body.second) return;
+		}
+		char open = m_data[body.first];
+		if(open != '[' && open != '{') return;
+		members = open == '{';
+		//Entries cut from the middle of the text may have lost their closing bracket
+		++body.first;
+		if(m_data[body.second - 1] == (members ? '}' : ']')) --body.second;
+	}
+
+	std::vector<Span> terms = splitTerms(m_data, body);
+	for(std::size_t i = 0; i < terms.size(); ++i){
+		std::string term = m_data.substr(terms[i].first, terms[i].second - terms[i].first);
+		if(!members) unwrapElement(term);
+		out.push_back(JSONEntry(term));
+	}
+}
+
+const JSONEntry JSONEntry::directMember(const std::string& key, bool inValue) const{
+	if(!m_valid) return JSONEntry(false);
+	if(m_table){
+		if(m_table->node(m_node).type != JSONNodeTable::ObjectNode) return JSONEntry(false);
+		return nodeMember(key.c_str());
+	}
+
+	//Text is the members of an object with or without its braces, or a member whose value is an object
+	Span body = trimSpan(m_data, Span(0, m_data.length()));
+	if(inValue){
+		std::string name;
+		if(endOfTerm(m_data, body.first, body.second) != body.second || !splitMember(m_data, body, name, body)) return JSONEntry(false);
+		if(body.first == body.second || m_data[body.first] != '{') return JSONEntry(false);
+	}
+	//Entries cut from the middle of the text may have lost their closing bracket
+	if(body.first < body.second && m_data[body.first] == '{'){
+		++body.first;
+		if(m_data[body.second - 1] == '}') --body.second;
+	}
+
+	Span found;
+	if(!findMemberTerm(m_data, body, key, found)) return JSONEntry(false);
+	return JSONEntry(m_data.substr(found.first, found.second - found.first));
+}
+
+bool JSONEntry::isMember() const{
+	if(!m_valid) return false;
+	if(m_table) return m_table->node(m_node).key != JSONNodeTable::none;
+	Span body = trimSpan(m_data, Span(0, m_data.length()));
+	return body.first < body.second && endOfTerm(m_data, body.first, body.second) == body.second && startsWithMember(m_data, body);
+}
+
+std::vector<std::string> diff(const JSONEntry& before, const JSONEntry& after){
+	std::vector<std::string> changes;
+	appendDiff(before, after, std::string(), changes);
+	return changes;
+}
+
+void appendDiff(const JSONEntry& before, const JSONEntry& after, const std::string& path, std::vector<std::string>& changes){
+	if(!before || !after){
+		if(before.valid() != after.valid()) changes.push_back(path);
+		return;
+	}
+
+	//Both sides are compared as nodes, whose hashes let whatever hasn't changed be passed over. Entries from a table are
+	//already nodes, and the text of any others is parsed once, into a table for the length of the diff.
+	const JSONEntry* entries[2] = { &before, &after };
+	const JSONNodeTable* tables[2];
+	std::size_t nodes[2];
+	ParsedTables parsed;
+	for(std::size_t i = 0; i < 2; ++i){
+		if(entries[i]->m_table){
+			tables[i] = entries[i]->m_table;
+			nodes[i] = entries[i]->m_node;
+			continue;
+		}
+
+		//Entries hold either a single member, e.g. "Name":"John", the members of an object with its braces removed (as array
+		//elements are), or a bare value. Members are parsed as an object of them.
+		const std::string& data = entries[i]->m_data;
+		Span span = trimSpan(data, Span(0, data.length()));
+		std::string source = data.substr(span.first, span.second - span.first);
+		if(startsWithMember(data, span)) source = "{" + source + "}";
+		parsed.tables[i] = new JSONNodeTable(source);
+		tables[i] = parsed.tables[i];
+		nodes[i] = JSONNodeTable::root();
+	}
+	if(!tables[0]->valid() || !tables[1]->valid()){
+		if(before != after) changes.push_back(path);
+		return;
+	}
+
+	//Members are compared as the members of an object, so their keys are compared too
+	std::vector<DiffMember> beforeMembers;
+	std::vector<DiffMember> afterMembers;
+	bool beforeHasMembers = membersOf(*tables[0], nodes[0], beforeMembers);
+	bool afterHasMembers = membersOf(*tables[1], nodes[1], afterMembers);
+	if(beforeHasMembers && afterHasMembers){
+		std::size_t changesBefore = changes.size();
+		diffMembers(*tables[0], beforeMembers, *tables[1], afterMembers, path, changes);
+		//Members which are all the same, but in a different order, still make a different entry
+		if(changes.size() == changesBefore && !sameKeyOrder(beforeMembers, afterMembers)) changes.push_back(path);
+	}
+	else if(!beforeHasMembers && !afterHasMembers) diffNodes(*tables[0], nodes[0], *tables[1], nodes[1], path, changes);
+	else changes.push_back(path);
+}
+
 std::pair<std::string::const_iterator,std::string::const_iterator> JSONEntry::key() const {
-	std::string::const_iterator it = m_data.begin();
-	std::string::const_iterator itfirst;
+	const std::string& data = text();
+	std::string::const_iterator it = data.begin();
+	std::string::const_iterator itfirst = data.end();
 	bool firstQuotes = false;
 
 	//Typical use will be much less than a full O(n)
-	while(it != m_data.end()){
-		if(*it == '\"'){
+	while(it != data.end()){
+		if(*it == '\\' && firstQuotes){
+			//Escaped characters in the key may include quote marks, so we skip over them
+			if(++it == data.end()) break;
+		}
+		else if(*it == '\"'){
 			if(!firstQuotes){
 				firstQuotes = true;
 				itfirst = it + 1;
@@ -155,11 +871,30 @@ std::size_t findEndOfTerm(const std::string& data, std::size_t startOfTerm){
 	//We want the position of the first "top level" comma or closing brace.
 	std::size_t braceCount = 0;
 	for(std::size_t i = startOfTerm; i < data.length(); ++i){
-		if(data[i] == '{' || data[i] == '[') ++braceCount;
+		if(data[i] == '\"') i = findEndOfString(data, i);
+		else if(data[i] == '{' || data[i] == '[') ++braceCount;
 		else if((data[i] == '}' || data[i] == ']') && braceCount > 0) --braceCount;
 		else if(braceCount == 0 && (data[i] == ',' || data[i] == '}')) return i;
 	}
     return data.length() - 1;
 }
 
+std::size_t findKey(const std::string& data, const char* key){
+	std::size_t keyLength = std::char_traits<char>::length(key);
+	//Keys are stored escaped, so if this one needs escaping we search for that form instead.
+	//The exception is a key which the user has entered with its own quote marks, which we take as-is.
+	if(findCharToEscape(key, keyLength) == keyLength || (keyLength > 1 && key[0] == '\"' && key[keyLength - 1] == '\"')){
+		return data.find(key, 0, keyLength);
+	}
+	return data.find(escapeString(std::string(key, keyLength)));
+}
 
+std::size_t findEndOfString(const std::string& data, std::size_t openingQuote){
+	//Strings can contain anything, including the characters we use for structure, so we skip them in one go
+	//taking care not to stop at any escaped quote marks.
+	for(std::size_t i = openingQuote + 1; i < data.length(); ++i){
+		if(data[i] == '\\') ++i;
+		else if(data[i] == '\"') return i;
+	}
+	return data.length() - 1;
+}
@@ -5,11 +5,14 @@
 //---------------------------------------------------------------------------
 
 #include <string>
+#include <vector>
 
 #include <cstdlib>
 #include <algorithm>
 
 #include "Tags.h"
+#include "JSONString.h"
+#include "JSONNodeTable.h"
 
 /*
 *  A class representing an entry in the JSON, which acts as a kind of proxy object (if we slightly loosen the definition of that term)
@@ -22,8 +25,27 @@
 std::string& trim(std::string& toTrim, const char* charsToTrim = " \t\r\n\b,{}[]");
 std::string trim(const std::string& toTrim, const char* charsToTrim = " \t\r\n\b,{}[]");
 
+//Prepare an element of an array to be an entry of its own: whitespace is trimmed, and objects have their braces removed
+std::string& unwrapElement(std::string& element);
+
 
 std::size_t findEndOfTerm(const std::string& data, std::size_t startOfTerm = 0);
+//Position of the given key within some JSON data, accounting for any escaping the key needs
+std::size_t findKey(const std::string& data, const char* key);
+//Position of the quote mark which closes the string opened at openingQuote
+std::size_t findEndOfString(const std::string& data, std::size_t openingQuote);
+
+
+class JSONEntry;
+class JSONReader;
+
+//The paths of everything which differs between two entries, with object members matched by key and array elements by index,
+//e.g. "users/3/name". Any branch which is unchanged is skipped over as a whole. An empty path means the entries as a whole.
+//Entries which aren't from an indexed reader are parsed once for the diff, and every object and array then has a hash, so
+//branches which differ are told apart by their hashes alone and the cost grows with the size of the data, not its depth.
+std::vector<std::string> diff(const JSONEntry& before, const JSONEntry& after);
+//As above, adding to an existing list, with each path under the one given
+void appendDiff(const JSONEntry& before, const JSONEntry& after, const std::string& path, std::vector<std::string>& changes);
 
 
 
@@ -34,10 +56,57 @@ public:
 
 	friend bool operator==(const JSONEntry& lhs, const JSONEntry& rhs);
 	friend bool operator!=(const JSONEntry& lhs, const JSONEntry& rhs);
+	friend void appendDiff(const JSONEntry& before, const JSONEntry& after, const std::string& path, std::vector<std::string>& changes);
+	friend std::vector<std::string> diff(const JSONReader& before, const JSONReader& after);
 
 	bool valid() const;
 	bool operator!() const;
 
+	//The type of the value. For a JSONReader which decodes scalars this was worked out as the file was parsed; otherwise it
+	//is worked out from the text each time. An entry which holds several members of an object, e.g. an element of an array
+	//of objects, is an ObjectValue, as is one which holds a key and an object. Anything which isn't valid JSON is an
+	//InvalidValue, as are invalid entries.
+	enum ValueType {
+		InvalidValue,
+		NullValue,
+		BoolValue,
+		IntegerValue,
+		DoubleValue,
+		StringValue,
+		ArrayValue,
+		ObjectValue
+	};
+	ValueType type() const;
+
+	bool isNull() const;
+	bool isBool() const;
+	//Integers and doubles alike
+	bool isNumber() const;
+	bool isInteger() const;
+	bool isString() const;
+	bool isArray() const;
+	bool isObject() const;
+
+	//A hash of the value which ignores whitespace, so that equal values always have equal hashes, and values with different
+	//hashes can be told apart without looking at their data. Values whose hashes match are still compared in full to be sure,
+	//so this only saves work when they differ. Entries of an indexed reader take it from the table, which hashes each object
+	//and array as it is parsed; for others it is calculated from the text on first use and kept with the entry. The top
+	//level entries of a JSONReader are hashed as the file is parsed, but nested entries are hashed when first needed.
+	std::size_t hash() const;
+
+	//How many lookups by key on the entries of an indexed reader found their member where it was predicted, and how many
+	//had to search, on the calling thread. Where the compiler has no storage for each thread, nothing is predicted or counted.
+	struct LookupStats {
+		unsigned long hits;
+		unsigned long misses;
+
+		double hitRate() const {
+			return (hits + misses == 0) ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+		}
+	};
+	static LookupStats lookupStats();
+	static void resetLookupStats();
+
 
 	//Returning by const value is intentional - operator[] can be chained repeatedly but no element which starts off const should be
 	//assignable at a later date
@@ -56,20 +125,29 @@ public:
 	//Note we use const char* as the overwhelming majority of use-cases will be from some string literal in the code,
 	//and taking that literal as directly as possible, rather than needing to construct a string around it every time,
 	//seemed like the optimal approach. An overload for std::string is provided.
+	//
+	//On the entries of an indexed reader, each key looked up remembers where it was found, by the address of the key, so that
+	//a loop which looks up the same key in every element of an array of records, e.g. Users["users"][i]["lastName"], can try
+	//the same member of the next one before searching. As objects with the same keys in the same order share a shape, this is
+	//usually right first time. Text entries are searched as before: the search already stops at the first match, so checking
+	//a remembered position first would save nothing.
 	template<std::size_t N>
 	const JSONEntry operator[](const char(&index)[N]) const {
-		std::size_t indexPos = m_data.find(index);
+		if (m_table) return predictedNodeMember(index, N);
+
+		std::size_t indexPos = findKey(m_data, index);
 		if (indexPos == std::string::npos) return JSONEntry(false);
 
+		//We step back one to avoid trimming off the first quote mark, e.g. JSONReader["B"] -> B":2 rather than "B":2
+		//This also means the term is scanned from its opening quote, so any escaped characters in it are skipped properly.
+		//We account for the possibility of the user manually entering the quote marks in the key using the trim.
+		if (indexPos > 0 && m_data[indexPos - 1] == '\"') --indexPos;
+
 		std::size_t nextComma = findEndOfTerm(m_data, indexPos);
 		//This one is not an error case. Simple entries in the file e.g. "Name":"John Smith" will be stored often.
 		//In this case, there will be no comma.
 		if (nextComma == std::string::npos) return *this;
 
-
-		//We subtract one to prevent us trimming off the first quote mark, e.g. JSONReader["B"] -> B":2 rather than "B":2
-		//We account for the possibility of the user manually entering the quote marks in the key using the trim.
-		--indexPos;
 		std::string newData = m_data.substr(indexPos, nextComma - indexPos + 1);
 		return JSONEntry(trim(newData, " \t\r\n\b,{}[:"));
 	}
@@ -98,10 +176,18 @@ public:
 	T as() const {
 		if (!m_valid) return as_helper<T>::get(m_data, instance_of<T>());
 
-		std::size_t colonPos = m_data.find(':');
-		std::string value;
-		if (colonPos != std::string::npos) value = m_data.substr(colonPos, findEndOfTerm(m_data, colonPos) - colonPos + 1);
-		else value = m_data;
+		//Where the value was decoded as the file was parsed, and is of a type which converts to T exactly as its text would,
+		//it is loaded directly. Otherwise simple values in an indexed reader are read straight out of its table, so the
+		//whole term is never built.
+		const JSONNodeTable::Scalar* decoded = m_table ? m_table->scalar(m_node) : 0;
+		T loaded = T();
+		if (decoded && as_helper<T>::load(*decoded, m_table->values().data() + m_table->node(m_node).begin, loaded, instance_of<T>())) {
+			return loaded;
+		}
+		std::string scalar;
+		if (m_table && nodeScalar(scalar)) return as_helper<T>::get(scalar, instance_of<T>());
+
+		std::pair<std::size_t, std::size_t> value = valueSpan();
 		/*
 		* In case you are unfamiliar with C++03 TMP techniques:
 		* To elaborate on the trick here - passing an instance_of<T> forces the compiler to look for an appropriate get()
@@ -110,8 +196,9 @@ public:
 		* As we have carefully designed are tags and overloads such that a given <T> will match no more than one constructor,
 		* the result is either a successful match to the function of the correct type, or a compiler failure if the user asks for
 		* an unsupported type.
+		* Quote marks are left on for the helpers to deal with, as the string overloads need them to decode the value.
 		*/
-		return as_helper<T>::get(trim(value, " \t\r\n\b,{}[]:\""), instance_of<T>());
+		return as_helper<T>::get(text().substr(value.first, value.second - value.first), instance_of<T>());
 	}
 
 
@@ -138,29 +225,67 @@ public:
 
 private:
 
-	std::string 	   	m_data;
+	//For entries backed by a node table, the text is only filled in if something needs it
+	mutable std::string	m_data;
 	bool        		m_valid;
 
+	//The node table and node this entry refers to, for entries from an indexed reader; null otherwise. The entry only points
+	//into the table, so it is valid for as long as the reader it came from, or a copy of it, or a writer it was spliced into.
+	const JSONNodeTable* m_table;
+	std::size_t         m_node;
+
+	//The cached hash() - as with the rest of the entry, it is never written to once the entry is shared between threads
+	mutable std::size_t m_hash;
+	mutable bool        m_hashed;
+
 
 	//Ctors
 	//As this is in many ways a proxy object, we only want it constructible from an object which represents actual
 	//JSON data. As such, constructors are private and only accessible to friends.
 	//"Invalid state" constructor - for failure cases
-	explicit JSONEntry(bool exists) : m_data("N/A"), m_valid(exists) {}
+	explicit JSONEntry(bool exists) : m_data("N/A"), m_valid(exists), m_table(0), m_node(0), m_hash(0), m_hashed(false) {}
 
 	//Primary constructors for handling data
-	explicit JSONEntry(const std::string& inData) : m_data(inData), m_valid(true) {}
+	explicit JSONEntry(const std::string& inData) : m_data(inData), m_valid(true), m_table(0), m_node(0), m_hash(0), m_hashed(false) {}
 
 	template<std::size_t N>
-	explicit JSONEntry(const char(&inData)[N]) : m_data(std::string(inData)), m_valid(true) {}
+	explicit JSONEntry(const char(&inData)[N])
+		: m_data(std::string(inData)), m_valid(true), m_table(0), m_node(0), m_hash(0), m_hashed(false) {}
+
+	//For a node of an indexed reader
+	JSONEntry(const JSONNodeTable* table, std::size_t node);
 
 	friend class JSONReader;
 	friend class JSONWriter;
+	friend class JSONStreamReader;
+	friend class JSONQuery;
 
 
 	//Primarily used for comparisons, this function returns iterators to the start and end of the key for this element
 	std::pair<std::string::const_iterator, std::string::const_iterator> key() const;
 
+	//The start and end of the value within m_data, with the surrounding punctuation trimmed away
+	std::pair<std::size_t, std::size_t> valueSpan() const;
+
+	//The entry as text, which for entries backed by a node is built on first use
+	const std::string& text() const;
+
+	//Lookups on entries backed by a node, which go straight to the node table rather than searching any text
+	const JSONEntry nodeChild(std::size_t index) const;
+	const JSONEntry nodeMember(const char* key) const;
+	//As nodeMember, trying the member predicted for the key first. The key is in an array of the given size.
+	const JSONEntry predictedNodeMember(const char* key, std::size_t size) const;
+	bool nodeScalar(std::string& out) const;
+
+	//Every element of an array, or member of an object, in a single pass. Each is as operator[] would return it.
+	void elements(std::vector<JSONEntry>& out) const;
+	//The member of an object with the given (unescaped) key, found among the object's own members only, rather than anywhere
+	//within it as operator[] finds it for text. For an entry which is itself a member of an object, e.g. one of its elements,
+	//inValue says to look in the object it holds; text can't otherwise tell that apart from an object of one member.
+	const JSONEntry directMember(const std::string& key, bool inValue) const;
+	//Whether the entry looks like a member of an object, i.e. "key":value, as elements() takes it to be
+	bool isMember() const;
+
 
 
 
@@ -172,31 +297,33 @@ private:
 	template<typename T>
 	struct as_helper {
 
+		//Strings are unquoted and have any escape sequences decoded
 		static inline T get(const std::string& src, tag_std_string) {
-			return T(src.begin(), src.end());
+			std::string decoded = decodeStringValue(src);
+			return T(decoded.begin(), decoded.end());
 		}
 
 #ifdef __TCPLUSPLUS__
 		static inline T get(const std::string& src, tag_delphi_string) {
-			return src.c_str();
+			return decodeStringValue(src).c_str();
 		}
 #endif
 
+		//Everything else just needs to skip past a leading quote mark, as numbers in particular are often stored as strings
 		static inline T get(const std::string& src, tag_floating_point) {
-			return static_cast<T>(std::atof(src.c_str()));
+			return static_cast<T>(std::atof(skipQuote(src)));
 		}
 
 		static inline T get(const std::string& src, tag_signed_int) {
-			return static_cast<T>(std::atol(src.c_str()));
+			return static_cast<T>(std::atol(skipQuote(src)));
 		}
 
 		static inline T get(const std::string& src, tag_unsigned_int) {
-			return static_cast<T>(std::strtoul(src.c_str(), NULL, 10));
+			return static_cast<T>(std::strtoul(skipQuote(src), NULL, 10));
 		}
 
 		static inline T get(const std::string& src, instance_of<bool>) {
-			if (src.empty()) return false;
-			switch (src[0]) {
+			switch (skipQuote(src)[0]) {
 			case 't':
 			case 'T':
 			case '1':
@@ -207,8 +334,68 @@ private:
 		}
 
 		static inline T get(const std::string& src, tag_char) {
-			if (src.empty()) return '0';
-			return static_cast<T>(src[0]);
+			std::string decoded = decodeStringValue(src);
+			if (decoded.empty()) return '0';
+			return static_cast<T>(decoded[0]);
+		}
+
+		/*
+		* The same again for decoded values, which are loaded into out and return true if the type of the value can be
+		* loaded directly. Otherwise they return false, and the value is converted from its text as above; this keeps
+		* conversions between types, e.g. of "12" to an int, exactly as they have always been.
+		* The text is that of the value in the table, starting from its opening quote mark for strings.
+		*/
+		static inline bool load(const JSONNodeTable::Scalar& value, const char* text, T& out, tag_std_string) {
+			if (value.type != JSONNodeTable::StringScalar) return false;
+			if (!value.escaped) {
+				out = T(text + 1, text + 1 + value.length);
+				return true;
+			}
+			std::string decoded;
+			decoded.reserve(value.length);
+			appendUnescaped(decoded, text + 1, value.length);
+			out = T(decoded.begin(), decoded.end());
+			return true;
+		}
+
+#ifdef __TCPLUSPLUS__
+		static inline bool load(const JSONNodeTable::Scalar&, const char*, T&, tag_delphi_string) {
+			return false;
+		}
+#endif
+
+		static inline bool load(const JSONNodeTable::Scalar& value, const char*, T& out, tag_floating_point) {
+			if (value.type == JSONNodeTable::IntegerScalar) out = static_cast<T>(value.integer);
+			else if (value.type == JSONNodeTable::DoubleScalar) out = static_cast<T>(value.number);
+			else return false;
+			return true;
+		}
+
+		static inline bool load(const JSONNodeTable::Scalar& value, const char*, T& out, tag_signed_int) {
+			if (value.type != JSONNodeTable::IntegerScalar) return false;
+			out = static_cast<T>(value.integer);
+			return true;
+		}
+
+		static inline bool load(const JSONNodeTable::Scalar& value, const char*, T& out, tag_unsigned_int) {
+			if (value.type != JSONNodeTable::IntegerScalar) return false;
+			out = static_cast<T>(value.integer);
+			return true;
+		}
+
+		static inline bool load(const JSONNodeTable::Scalar& value, const char*, T& out, instance_of<bool>) {
+			if (value.type != JSONNodeTable::BoolScalar) return false;
+			out = value.boolean;
+			return true;
+		}
+
+		static inline bool load(const JSONNodeTable::Scalar&, const char*, T&, tag_char) {
+			return false;
+		}
+
+		static inline const char* skipQuote(const std::string& src) {
+			const char* text = src.c_str();
+			return (*text == '\"') ? text + 1 : text;
 		}
 
 	};
@@ -0,0 +1,133 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "JSONIOThread.h"
+
+#ifdef JSON_03_CXX11
+
+#include <fcntl.h>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+JSONIOThread& JSONIOThread::io(){
+	//The I/O thread posts files it has read to the parser, so the parser is created first and hence destroyed last
+	parser();
+	static JSONIOThread thread;
+	return thread;
+}
+
+JSONIOThread& JSONIOThread::formatter(){
+	//The formatter posts work to the I/O thread, so we make sure the I/O thread is created first and hence destroyed last
+	io();
+	static JSONIOThread thread;
+	return thread;
+}
+
+JSONIOThread& JSONIOThread::parser(){
+	static JSONIOThread thread;
+	return thread;
+}
+
+JSONIOThread::JSONIOThread() : m_stopping(false), m_thread(&JSONIOThread::run, this) {}
+
+JSONIOThread::~JSONIOThread(){
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_ready.notify_one();
+	m_thread.join();
+}
+
+void JSONIOThread::post(const std::function<void()>& task){
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(task);
+	}
+	m_ready.notify_one();
+}
+
+void JSONIOThread::run(){
+	for(;;){
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_ready.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if(m_tasks.empty()) return;
+			task.swap(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+
+#ifdef _WIN32
+JSONOutputFile::JSONOutputFile(const std::string& filePathAndName, bool append)
+	: m_handle(_open(filePathAndName.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (append ? _O_APPEND : _O_TRUNC), _S_IREAD | _S_IWRITE)) {}
+#else
+JSONOutputFile::JSONOutputFile(const std::string& filePathAndName, bool append)
+	: m_handle(open(filePathAndName.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666)) {}
+#endif
+
+JSONOutputFile::~JSONOutputFile(){
+	close();
+}
+
+bool JSONOutputFile::valid() const{
+	return m_handle >= 0;
+}
+
+bool JSONOutputFile::write(const char* data, std::size_t length){
+	if(!valid()) return false;
+	//The OS is allowed to write less than we asked for, so we keep going until it's all out
+	while(length > 0){
+#ifdef _WIN32
+		int written = _write(m_handle, data, static_cast<unsigned int>(length));
+#else
+		ssize_t written = ::write(m_handle, data, length);
+#endif
+		if(written < 0){
+			if(errno == EINTR) continue;
+			return false;
+		}
+		data += written;
+		length -= static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+bool JSONOutputFile::sync(){
+	if(!valid()) return false;
+#if defined(_WIN32)
+	return _commit(m_handle) == 0;
+#elif defined(__APPLE__)
+	return fsync(m_handle) == 0;
+#else
+	return fdatasync(m_handle) == 0;
+#endif
+}
+
+bool JSONOutputFile::close(){
+	if(!valid()) return false;
+#ifdef _WIN32
+	bool closed = _close(m_handle) == 0;
+#else
+	bool closed = ::close(m_handle) == 0;
+#endif
+	m_handle = -1;
+	return closed;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef JSON_03_IO_THREAD
+#define JSON_03_IO_THREAD
+
+#include "JSONConfig.h"
+
+#ifdef JSON_03_CXX11
+
+#include <string>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+*  Support for the asynchronous loadAsync()/writeToFileAsync() functions, which need a C++11 standard library.
+*  Rather than starting a thread per call, all file I/O is queued onto one long-lived background thread, and the formatting of
+*  data to be written goes onto a second. That way a write can format its next chunk while the previous one is being written.
+*  Files which have been read are parsed on a third, so that a large parse never holds up the files queued after it.
+*/
+
+
+class JSONIOThread {
+public:
+
+	//The thread which reads and writes files, the one which formats data for writing, and the one which parses data read
+	static JSONIOThread& io();
+	static JSONIOThread& formatter();
+	static JSONIOThread& parser();
+
+	//Tasks are run in the order they are posted
+	void post(const std::function<void()>& task);
+
+	//Any tasks still queued are run before the thread finishes
+	~JSONIOThread();
+
+private:
+
+	std::mutex                        m_mutex;
+	std::condition_variable           m_ready;
+	std::deque<std::function<void()>> m_tasks;
+	bool                              m_stopping;
+	std::thread                       m_thread;
+
+	JSONIOThread();
+	void run();
+
+	JSONIOThread(const JSONIOThread&);
+	JSONIOThread& operator=(const JSONIOThread&);
+};
+
+
+
+//A file opened for writing with the OS's own calls, so that we can control exactly when data is written and flushed to disk
+class JSONOutputFile {
+public:
+
+	JSONOutputFile(const std::string& filePathAndName, bool append);
+	~JSONOutputFile();
+
+	bool valid() const;
+
+	bool write(const char* data, std::size_t length);
+	//Have the data reach the disk (fdatasync), rather than just the OS's cache
+	bool sync();
+	bool close();
+
+private:
+
+	int m_handle;
+
+	JSONOutputFile(const JSONOutputFile&);
+	JSONOutputFile& operator=(const JSONOutputFile&);
+};
+
+#endif
+#endif
@@ -0,0 +1,87 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "JSONKeyIndex.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+std::size_t hashBytes(const char* data, std::size_t length){
+	std::size_t hash = fnvOffsetBasis;
+	for(std::size_t i = 0; i < length; ++i){
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= fnvPrime;
+	}
+	return hash;
+}
+
+JSONKeyIndex::JSONKeyIndex(std::size_t expectedSize) : m_size(0) {
+	std::size_t capacity = 8;
+	while(capacity < expectedSize * 2) capacity *= 2;
+
+	Slot empty = { 0, npos };
+	m_slots.assign(capacity, empty);
+}
+
+void JSONKeyIndex::insert(std::size_t hash, std::size_t value){
+	if((m_size + 1) * 2 > m_slots.size()) grow();
+
+	//Linear probing, so the new value goes in the first free slot after any which are already there
+	std::size_t mask = m_slots.size() - 1;
+	std::size_t slot = hash & mask;
+	while(m_slots[slot].value != npos) slot = (slot + 1) & mask;
+
+	m_slots[slot].hash = hash;
+	m_slots[slot].value = value;
+	++m_size;
+}
+
+std::size_t JSONKeyIndex::first(std::size_t hash) const{
+	return probeFrom(hash, hash & (m_slots.size() - 1));
+}
+
+std::size_t JSONKeyIndex::next(std::size_t hash, std::size_t slot) const{
+	return probeFrom(hash, (slot + 1) & (m_slots.size() - 1));
+}
+
+std::size_t JSONKeyIndex::value(std::size_t slot) const{
+	return m_slots[slot].value;
+}
+
+std::size_t JSONKeyIndex::size() const{
+	return m_size;
+}
+
+std::size_t JSONKeyIndex::memoryUsage() const{
+	return m_slots.capacity() * sizeof(Slot);
+}
+
+std::size_t JSONKeyIndex::probeFrom(std::size_t hash, std::size_t slot) const{
+	//There is always at least one empty slot, which ends the probe sequence
+	std::size_t mask = m_slots.size() - 1;
+	while(m_slots[slot].value != npos){
+		if(m_slots[slot].hash == hash) return slot;
+		slot = (slot + 1) & mask;
+	}
+	return npos;
+}
+
+void JSONKeyIndex::grow(){
+	//Reinserting in slot order would not keep values with the same hash in insertion order, so we walk each cluster from
+	//its start instead: an empty slot is always followed by the start of a cluster.
+	std::vector<Slot> oldSlots;
+	oldSlots.swap(m_slots);
+
+	Slot empty = { 0, npos };
+	m_slots.assign(oldSlots.size() * 2, empty);
+	m_size = 0;
+
+	std::size_t oldMask = oldSlots.size() - 1;
+	std::size_t start = 0;
+	while(oldSlots[start].value != npos) ++start;
+	for(std::size_t i = 1; i <= oldSlots.size(); ++i){
+		const Slot& slot = oldSlots[(start + i) & oldMask];
+		if(slot.value != npos) insert(slot.hash, slot.value);
+	}
+}
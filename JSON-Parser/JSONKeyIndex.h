@@ -0,0 +1,64 @@
+#ifndef JSON_03_KEY_INDEX
+#define JSON_03_KEY_INDEX
+
+#include <vector>
+#include <cstddef>
+
+/*
+*  A small open-addressed hash table from the hash of a key to some index of the user's choosing, e.g. the position of an entry.
+*  The keys themselves are not stored - they already live in the data being indexed, and storing them again would double up
+*  on memory - so the user is handed each candidate stored under a hash and checks the key for themselves:
+*
+*	for(std::size_t slot = index.first(hash); slot != JSONKeyIndex::npos; slot = index.next(hash, slot)){
+*		if(keyAt(index.value(slot)) == key) return index.value(slot);
+*	}
+*
+*  Values stored under the same hash are visited in the order they were inserted.
+*/
+
+//FNV-1a, which is simple, quick on short keys like ours and spreads them well enough
+std::size_t hashBytes(const char* data, std::size_t length);
+
+//The FNV offset basis and prime for the width of std::size_t, so that 64 bit targets get the 64 bit variant of the hash.
+//C++03 has no 64 bit literals, so those values are put together from two halves; the shifts are split in two so that
+//they are still well defined where std::size_t is 32 bits, and the 32 bit values are used.
+const bool        fnvWide = sizeof(std::size_t) >= 8;
+const std::size_t fnvOffsetBasis = fnvWide ? (((static_cast<std::size_t>(0xcbf29ce4ul) << 16) << 16) | 0x84222325ul) : 2166136261ul;
+const std::size_t fnvPrime = fnvWide ? (((static_cast<std::size_t>(0x100ul) << 16) << 16) | 0x1b3ul) : 16777619ul;
+
+
+class JSONKeyIndex {
+public:
+
+	static const std::size_t npos = static_cast<std::size_t>(-1);
+
+	explicit JSONKeyIndex(std::size_t expectedSize = 0);
+
+	void insert(std::size_t hash, std::size_t value);
+
+	//Probing for the values stored under a hash. These return the slot of the next candidate, or npos when there are no more.
+	std::size_t first(std::size_t hash) const;
+	std::size_t next(std::size_t hash, std::size_t slot) const;
+	std::size_t value(std::size_t slot) const;
+
+	std::size_t size() const;
+	//The bytes the index holds on the heap
+	std::size_t memoryUsage() const;
+
+private:
+
+	struct Slot {
+		std::size_t hash;
+		std::size_t value;
+	};
+
+	//Always a power of two in size, and never more than half full, so probe sequences stay short
+	std::vector<Slot> m_slots;
+	std::size_t       m_size;
+
+	std::size_t probeFrom(std::size_t hash, std::size_t slot) const;
+	void grow();
+
+};
+
+#endif
@@ -0,0 +1,546 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include "JSONNodeTable.h"
+#include "JSONEntry.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+JSONNodeTable::JSONNodeTable(std::string& source, bool decodeScalars)
+	: m_decodeScalars(decodeScalars), m_valid(false), m_references(1) {
+	m_valid = parse(source);
+	std::string().swap(source);
+
+	//The lists were grown as the source was parsed, so they are trimmed of the room they have to spare
+	std::string(m_values).swap(m_values);
+	std::vector<PackedNode>(m_nodes).swap(m_nodes);
+	std::vector<Container>(m_containers).swap(m_containers);
+	std::vector<Scalar>(m_scalars).swap(m_scalars);
+}
+
+bool JSONNodeTable::valid() const{
+	return m_valid;
+}
+
+const std::string& JSONNodeTable::values() const{
+	return m_values;
+}
+
+JSONNodeTable::Node JSONNodeTable::node(std::size_t index) const{
+	const PackedNode& packed = m_nodes[index];
+	Offset key = packed.keyAndType & keyMask;
+	Node node = { 0, 0, key == keyMask ? none : key, 0, 0, none, nodeType(index) };
+	if(node.type == ScalarNode){
+		node.begin = packed.data;
+		if(m_values[node.begin] == '\"') node.end = static_cast<Offset>(findEndOfString(m_values, node.begin) + 1);
+		else node.end = static_cast<Offset>(m_values.find(',', node.begin));
+	}
+	else{
+		const Container& container = m_containers[packed.data];
+		node.children = container.children;
+		node.childCount = container.childCount;
+		node.shape = container.shape;
+	}
+	return node;
+}
+
+JSONNodeTable::NodeType JSONNodeTable::nodeType(std::size_t index) const{
+	return static_cast<NodeType>(m_nodes[index].keyAndType >> keyBits);
+}
+
+std::size_t JSONNodeTable::root(){
+	return 0;
+}
+
+std::size_t JSONNodeTable::child(std::size_t parent, std::size_t position) const{
+	if(nodeType(parent) == ScalarNode) return npos;
+	const Container& container = m_containers[m_nodes[parent].data];
+	if(position >= container.childCount) return npos;
+	return container.children + position;
+}
+
+std::size_t JSONNodeTable::member(std::size_t object, const char* key, std::size_t length) const{
+	if(nodeType(object) != ObjectNode) return npos;
+	const Container& container = m_containers[m_nodes[object].data];
+	std::size_t id = keyID(key, length);
+	if(id == npos) return npos;
+	std::size_t position = slot(container.shape, id);
+	if(position == npos) return npos;
+	return container.children + position;
+}
+
+std::size_t JSONNodeTable::keyID(const char* key, std::size_t length) const{
+	std::size_t hash = hashBytes(key, length);
+	for(std::size_t slot = m_keyIndex.first(hash); slot != JSONKeyIndex::npos; slot = m_keyIndex.next(hash, slot)){
+		const std::string& candidate = m_keys[m_keyIndex.value(slot)];
+		if(candidate.length() == length && std::memcmp(candidate.data(), key, length) == 0) return m_keyIndex.value(slot);
+	}
+	return npos;
+}
+
+const std::string& JSONNodeTable::keyName(std::size_t id) const{
+	return m_keys[id];
+}
+
+std::size_t JSONNodeTable::slot(std::size_t shape, std::size_t keyID) const{
+	//Each key is only in the index of a shape once, so the first candidate is the only one
+	const JSONKeyIndex& slots = m_shapes[shape].slots;
+	std::size_t found = slots.first(keyID);
+	return found == JSONKeyIndex::npos ? npos : slots.value(found);
+}
+
+std::string JSONNodeTable::text(std::size_t index) const{
+	std::string out;
+	appendText(out, index);
+	return out;
+}
+
+void JSONNodeTable::appendText(std::string& out, std::size_t index) const{
+	/*
+	*  As with parsing, this is done without recursion. Each object or array being written is kept on a stack along with how
+	*  many of its children have been written so far. The node asked for is written without the braces of an object, so that
+	*  it is left at the bottom of the stack with nothing written for it.
+	*/
+	std::vector<std::pair<std::size_t, std::size_t> > open;
+	Node top = node(index);
+	if(top.key != none){
+		out += '\"';
+		out += m_keys[top.key];
+		out += "\":";
+	}
+	if(top.type == ScalarNode){
+		out.append(m_values, top.begin, top.end - top.begin);
+		return;
+	}
+	if(top.type == ArrayNode || top.key != none) out += (top.type == ObjectNode) ? '{' : '[';
+	open.push_back(std::make_pair(index, 0));
+
+	while(!open.empty()){
+		const Container& container = m_containers[m_nodes[open.back().first].data];
+		std::size_t position = open.back().second++;
+		if(position == container.childCount){
+			bool bare = open.size() == 1 && nodeType(index) == ObjectNode && top.key == none;
+			if(!bare) out += (nodeType(open.back().first) == ObjectNode) ? '}' : ']';
+			open.pop_back();
+			continue;
+		}
+		if(position > 0) out += ',';
+
+		std::size_t childIndex = container.children + position;
+		Node child = node(childIndex);
+		if(child.key != none){
+			out += '\"';
+			out += m_keys[child.key];
+			out += "\":";
+		}
+		if(child.type == ScalarNode) out.append(m_values, child.begin, child.end - child.begin);
+		else{
+			out += (child.type == ObjectNode) ? '{' : '[';
+			open.push_back(std::make_pair(childIndex, 0));
+		}
+	}
+}
+
+std::size_t JSONNodeTable::nodeCount() const{
+	return m_nodes.size();
+}
+
+std::size_t JSONNodeTable::keyCount() const{
+	return m_keys.size();
+}
+
+std::size_t JSONNodeTable::shapeCount() const{
+	return m_shapes.size();
+}
+
+std::size_t JSONNodeTable::memoryUsage() const{
+	std::size_t bytes = m_values.capacity() + m_nodes.capacity() * sizeof(PackedNode) + m_containers.capacity() * sizeof(Container)
+		+ m_scalars.capacity() * sizeof(Scalar);
+	bytes += m_keys.capacity() * sizeof(std::string) + m_keyIndex.memoryUsage();
+	for(std::size_t i = 0; i < m_keys.size(); ++i) bytes += m_keys[i].capacity();
+	bytes += m_shapes.capacity() * sizeof(Shape) + m_shapeIndex.memoryUsage();
+	for(std::size_t i = 0; i < m_shapes.size(); ++i){
+		bytes += m_shapes[i].keys.capacity() * sizeof(Offset) + m_shapes[i].slots.memoryUsage();
+	}
+	return bytes;
+}
+
+const JSONNodeTable::Scalar* JSONNodeTable::scalar(std::size_t index) const{
+	return m_decodeScalars ? &m_scalars[index] : 0;
+}
+
+namespace {
+
+	bool isDigit(char c){
+		return c >= '0' && c <= '9';
+	}
+
+	//The length of the number at the start of the text per the grammar in RFC 8259, or 0 if there isn't one, along with
+	//whether it has a fraction or exponent
+	std::size_t scanNumber(const char* text, std::size_t length, bool& integer){
+		std::size_t pos = 0;
+		if(pos < length && text[pos] == '-') ++pos;
+		if(pos == length || !isDigit(text[pos])) return 0;
+		//No leading zeroes
+		if(text[pos] == '0') ++pos;
+		else while(pos < length && isDigit(text[pos])) ++pos;
+
+		integer = true;
+		if(pos < length && text[pos] == '.'){
+			integer = false;
+			if(++pos == length || !isDigit(text[pos])) return 0;
+			while(pos < length && isDigit(text[pos])) ++pos;
+		}
+		if(pos < length && (text[pos] == 'e' || text[pos] == 'E')){
+			integer = false;
+			if(++pos < length && (text[pos] == '+' || text[pos] == '-')) ++pos;
+			if(pos == length || !isDigit(text[pos])) return 0;
+			while(pos < length && isDigit(text[pos])) ++pos;
+		}
+		return pos;
+	}
+
+}
+
+namespace {
+
+	//FNV-1a, carried on from a hash so far
+	std::size_t hashMore(std::size_t hash, const char* data, std::size_t length){
+		for(std::size_t i = 0; i < length; ++i){
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= fnvPrime;
+		}
+		return hash;
+	}
+
+	bool isString(const char* text, std::size_t length){
+		return length >= 2 && text[0] == '\"' && text[length - 1] == '\"';
+	}
+
+	//Scalars with the same text are equal, and so are strings which only differ in how they are escaped
+	bool scalarEqual(const char* lhs, std::size_t lhsLength, const char* rhs, std::size_t rhsLength){
+		if(lhsLength == rhsLength && std::memcmp(lhs, rhs, lhsLength) == 0) return true;
+		if(!isString(lhs, lhsLength) || !isString(rhs, rhsLength)) return false;
+		if(!std::memchr(lhs, '\\', lhsLength) && !std::memchr(rhs, '\\', rhsLength)) return false;
+		std::string lhsDecoded;
+		std::string rhsDecoded;
+		appendUnescaped(lhsDecoded, lhs + 1, lhsLength - 2);
+		appendUnescaped(rhsDecoded, rhs + 1, rhsLength - 2);
+		return lhsDecoded == rhsDecoded;
+	}
+
+}
+
+std::size_t JSONNodeTable::hash(std::size_t index) const{
+	const PackedNode& packed = m_nodes[index];
+	if((packed.keyAndType & keyMask) == keyMask && nodeType(index) == ObjectNode && m_containers[packed.data].childCount == 1){
+		return valueHash(m_containers[packed.data].children);
+	}
+	return valueHash(index);
+}
+
+std::size_t JSONNodeTable::valueHash(std::size_t index) const{
+	if(nodeType(index) != ScalarNode) return m_containers[m_nodes[index].data].hash;
+	Node scalar = node(index);
+	return scalarHash(m_values.data() + scalar.begin, scalar.end - scalar.begin);
+}
+
+std::size_t JSONNodeTable::scalarHash(const char* text, std::size_t length){
+	//Strings are hashed on their decoded contents, after a mark which keeps them apart from other values with that text
+	if(!isString(text, length)) return hashMore(fnvOffsetBasis, text, length);
+	std::size_t hash = hashMore(fnvOffsetBasis, "\"", 1);
+	if(!std::memchr(text + 1, '\\', length - 2)) return hashMore(hash, text + 1, length - 2);
+	std::string decoded;
+	appendUnescaped(decoded, text + 1, length - 2);
+	return hashMore(hash, decoded.data(), decoded.length());
+}
+
+std::size_t JSONNodeTable::containerHash(NodeType type){
+	return hashMore(fnvOffsetBasis, (type == ObjectNode) ? "{" : "[", 1);
+}
+
+std::size_t JSONNodeTable::memberHash(const char* key, std::size_t length, std::size_t valueHash){
+	return addHash(hashMore(fnvOffsetBasis, key, length), valueHash);
+}
+
+std::size_t JSONNodeTable::addHash(std::size_t containerHash, std::size_t childHash){
+	return (containerHash ^ childHash) * fnvPrime;
+}
+
+bool JSONNodeTable::equal(const JSONNodeTable& lhs, std::size_t lhsIndex, const JSONNodeTable& rhs, std::size_t rhsIndex){
+	//As elsewhere, without recursion: the pairs of nodes still to be compared are kept on a stack
+	std::vector<std::pair<std::size_t, std::size_t> > pending(1, std::make_pair(lhsIndex, rhsIndex));
+	while(!pending.empty()){
+		std::size_t l = pending.back().first;
+		std::size_t r = pending.back().second;
+		pending.pop_back();
+
+		Node lhsNode = lhs.node(l);
+		Node rhsNode = rhs.node(r);
+		if(lhsNode.type != rhsNode.type) return false;
+		if(lhsNode.type == ScalarNode){
+			if(!scalarEqual(lhs.m_values.data() + lhsNode.begin, lhsNode.end - lhsNode.begin, rhs.m_values.data() + rhsNode.begin,
+				rhsNode.end - rhsNode.begin)) return false;
+			continue;
+		}
+
+		if(lhsNode.childCount != rhsNode.childCount || lhs.valueHash(l) != rhs.valueHash(r)) return false;
+		for(std::size_t i = 0; i < lhsNode.childCount; ++i){
+			if(lhsNode.type == ObjectNode){
+				const std::string& lhsKey = lhs.m_keys[lhs.m_nodes[lhsNode.children + i].keyAndType & keyMask];
+				const std::string& rhsKey = rhs.m_keys[rhs.m_nodes[rhsNode.children + i].keyAndType & keyMask];
+				if(lhsKey != rhsKey) return false;
+			}
+			pending.push_back(std::make_pair(lhsNode.children + i, rhsNode.children + i));
+		}
+	}
+	return true;
+}
+
+JSONNodeTable::Scalar JSONNodeTable::decode(const char* text, std::size_t length){
+	Scalar out;
+	out.type = UndecodedScalar;
+	out.escaped = false;
+	out.length = 0;
+	if(length == 0) return out;
+
+	switch(text[0]){
+	case '\"':
+		if(length < 2 || text[length - 1] != '\"') return out;
+		out.type = StringScalar;
+		out.length = length - 2;
+		out.escaped = std::memchr(text + 1, '\\', length - 2) != 0;
+		return out;
+	case 't':
+	case 'f':
+		if((length == 4 && std::memcmp(text, "true", 4) == 0) || (length == 5 && std::memcmp(text, "false", 5) == 0)){
+			out.type = BoolScalar;
+			out.boolean = text[0] == 't';
+		}
+		return out;
+	case 'n':
+		if(length == 4 && std::memcmp(text, "null", 4) == 0) out.type = NullScalar;
+		return out;
+	}
+
+	bool integer = false;
+	if(scanNumber(text, length, integer) != length) return out;
+	//The text may run straight on into the next value, so the number is copied out for the C library to stop at its end
+	char buffer[64];
+	std::string longNumber;
+	const char* number = buffer;
+	if(length < sizeof(buffer)){
+		std::memcpy(buffer, text, length);
+		buffer[length] = '\0';
+	}
+	else{
+		longNumber.assign(text, length);
+		number = longNumber.c_str();
+	}
+	if(integer){
+		errno = 0;
+		char* end = 0;
+#ifdef JSON_03_CXX11
+		json_int value = std::strtoll(number, &end, 10);
+#else
+		json_int value = std::strtol(number, &end, 10);
+#endif
+		if(errno != ERANGE){
+			out.type = IntegerScalar;
+			out.integer = value;
+			return out;
+		}
+	}
+	out.type = DoubleScalar;
+	out.number = std::strtod(number, NULL);
+	return out;
+}
+
+void JSONNodeTable::addReference() const{
+	m_references.increment();
+}
+
+bool JSONNodeTable::release() const{
+	return m_references.decrement() == 0;
+}
+
+JSONNodeTable::Reference::Reference(const JSONNodeTable* table) : m_table(table) {
+	if(m_table) m_table->addReference();
+}
+
+JSONNodeTable::Reference::Reference(const Reference& other) : m_table(other.m_table) {
+	if(m_table) m_table->addReference();
+}
+
+JSONNodeTable::Reference& JSONNodeTable::Reference::operator=(const Reference& other){
+	if(other.m_table) other.m_table->addReference();
+	if(m_table && m_table->release()) delete m_table;
+	m_table = other.m_table;
+	return *this;
+}
+
+JSONNodeTable::Reference::~Reference(){
+	if(m_table && m_table->release()) delete m_table;
+}
+
+std::size_t JSONNodeTable::skipWhitespace(const std::string& source, std::size_t pos){
+	while(pos < source.length() && std::strchr(" \t\r\n\b", source[pos]) && source[pos] != '\0') ++pos;
+	return pos;
+}
+
+bool JSONNodeTable::parse(const std::string& source){
+	/*
+	*  A single pass over the source without recursion, so deeply nested data can't overflow the stack. The objects and arrays
+	*  which are currently open are kept on a stack, along with where their children start in a second stack of children
+	*  which are still pending. When a container closes, its children are moved over to m_nodes in one go, which keeps the
+	*  children of each container together, and the container itself becomes pending in its parent. The root is closed last,
+	*  so its place at the start is kept for it.
+	*/
+	std::vector<OpenContainer> open;
+	std::vector<PackedNode> pending;
+	std::vector<Scalar> pendingScalars;
+	std::vector<Offset> shapeKeys;
+
+	//Positions are kept in 32 bits
+	if(source.length() >= none) return false;
+	m_nodes.push_back(PackedNode());
+	if(m_decodeScalars) m_scalars.push_back(decode(0, 0));
+
+	std::size_t pos = skipWhitespace(source, 0);
+	for(;;){
+		//Inside an object, each value is preceded by its key
+		Offset key = keyMask;
+		if(!open.empty() && (open.back().node.keyAndType >> keyBits) == ObjectNode){
+			if(pos >= source.length() || source[pos] != '\"') return false;
+			std::size_t keyEnd = findEndOfString(source, pos);
+			if(keyEnd <= pos || source[keyEnd] != '\"') return false;
+			key = static_cast<Offset>(internKey(source.data() + pos + 1, keyEnd - pos - 1));
+			if(key >= keyMask) return false;
+
+			pos = skipWhitespace(source, keyEnd + 1);
+			if(pos >= source.length() || source[pos] != ':') return false;
+			pos = skipWhitespace(source, pos + 1);
+		}
+		if(pos >= source.length()) return false;
+
+		char c = source[pos];
+		bool opened = false;
+		if(c == '{' || c == '['){
+			NodeType type = (c == '{') ? ObjectNode : ArrayNode;
+			Container container = { 0, 0, none, 0 };
+			OpenContainer opening = { { static_cast<Offset>(m_containers.size()), key | (static_cast<Offset>(type) << keyBits) },
+				static_cast<Offset>(pending.size()) };
+			open.push_back(opening);
+			m_containers.push_back(container);
+			pos = skipWhitespace(source, pos + 1);
+			opened = true;
+		}
+		else{
+			std::size_t end = 0;
+			if(c == '\"'){
+				end = findEndOfString(source, pos) + 1;
+				if(end <= pos + 1 || source[end - 1] != '\"') return false;
+			}
+			else{
+				end = std::min(source.find_first_of(" \t\r\n\b,}]", pos), source.length());
+				if(end == pos) return false;
+			}
+			PackedNode node = { static_cast<Offset>(m_values.length()), key | (static_cast<Offset>(ScalarNode) << keyBits) };
+			m_values.append(source, pos, end - pos);
+			if(c != '\"') m_values += ',';
+			if(open.empty()) m_nodes[root()] = node;
+			else pending.push_back(node);
+			if(m_decodeScalars){
+				Scalar decoded = decode(source.c_str() + pos, end - pos);
+				if(open.empty()) m_scalars[root()] = decoded;
+				else pendingScalars.push_back(decoded);
+			}
+			pos = skipWhitespace(source, end);
+		}
+
+		//Now close as many containers as end here, until we reach a comma which says another value follows
+		for(bool first = true;; first = false){
+			if(open.empty()) return pos == source.length();
+			if(pos >= source.length()) return false;
+
+			PackedNode closed = open.back().node;
+			NodeType type = static_cast<NodeType>(closed.keyAndType >> keyBits);
+			char closing = (type == ObjectNode) ? '}' : ']';
+			if(source[pos] == ',' && !(opened && first)){
+				pos = skipWhitespace(source, pos + 1);
+				break;
+			}
+			if(source[pos] != closing){
+				//A freshly opened container with something in it goes straight on to its first value
+				if(opened && first) break;
+				return false;
+			}
+
+			std::size_t firstPending = open.back().firstPending;
+			Container& container = m_containers[closed.data];
+			container.children = static_cast<Offset>(m_nodes.size());
+			container.childCount = static_cast<Offset>(pending.size() - firstPending);
+			m_nodes.insert(m_nodes.end(), pending.begin() + firstPending, pending.end());
+			pending.resize(firstPending);
+			if(m_decodeScalars){
+				m_scalars.insert(m_scalars.end(), pendingScalars.begin() + firstPending, pendingScalars.end());
+				pendingScalars.resize(firstPending);
+			}
+
+			//The container is hashed from its children, whose own hashes are either worked out already or quick to work out
+			shapeKeys.clear();
+			container.hash = containerHash(type);
+			for(std::size_t i = 0; i < container.childCount; ++i){
+				std::size_t child = container.children + i;
+				std::size_t childHash = valueHash(child);
+				if(type == ObjectNode){
+					Offset childKey = m_nodes[child].keyAndType & keyMask;
+					shapeKeys.push_back(childKey);
+					childHash = memberHash(m_keys[childKey].data(), m_keys[childKey].length(), childHash);
+				}
+				container.hash = addHash(container.hash, childHash);
+			}
+			if(type == ObjectNode) container.shape = internShape(shapeKeys);
+
+			open.pop_back();
+			if(open.empty()) m_nodes[root()] = closed;
+			else{
+				pending.push_back(closed);
+				if(m_decodeScalars) pendingScalars.push_back(decode(0, 0));
+			}
+			pos = skipWhitespace(source, pos + 1);
+		}
+	}
+}
+
+std::size_t JSONNodeTable::internKey(const char* key, std::size_t length){
+	std::size_t existing = keyID(key, length);
+	if(existing != npos) return existing;
+
+	m_keys.push_back(std::string(key, length));
+	m_keyIndex.insert(hashBytes(key, length), m_keys.size() - 1);
+	return m_keys.size() - 1;
+}
+
+JSONNodeTable::Offset JSONNodeTable::internShape(const std::vector<Offset>& keys){
+	std::size_t hash = keys.empty() ? 0 : hashBytes(reinterpret_cast<const char*>(&keys[0]), keys.size() * sizeof(Offset));
+	for(std::size_t slot = m_shapeIndex.first(hash); slot != JSONKeyIndex::npos; slot = m_shapeIndex.next(hash, slot)){
+		if(m_shapes[m_shapeIndex.value(slot)].keys == keys) return static_cast<Offset>(m_shapeIndex.value(slot));
+	}
+
+	m_shapes.push_back(Shape());
+	Shape& shape = m_shapes.back();
+	shape.keys = keys;
+	//Where an object has the same key more than once, lookups find the first, as they do elsewhere
+	for(std::size_t i = 0; i < keys.size(); ++i){
+		if(shape.slots.first(keys[i]) == JSONKeyIndex::npos) shape.slots.insert(keys[i], i);
+	}
+	m_shapeIndex.insert(hash, m_shapes.size() - 1);
+	return static_cast<Offset>(m_shapes.size() - 1);
+}
@@ -0,0 +1,226 @@
+#ifndef JSON_03_NODE_TABLE
+#define JSON_03_NODE_TABLE
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "JSONConfig.h"
+#include "JSONAtomic.h"
+#include "JSONKeyIndex.h"
+
+/*
+*  The parsed form of a document, for JSONReader's indexed mode. The source itself isn't kept: the text of every scalar is
+*  copied once, one after another, into a buffer of values without any of the keys, punctuation or whitespace around them, and
+*  every value in the document is a node which refers to its place in that buffer or, for objects and arrays, to its children.
+*  The children of each object or array are stored next to each other, so a child is found by its position alone. The text
+*  of an object or array is written out from its nodes when it is asked for.
+*
+*  Keys are interned: each distinct key is stored once, and the members of objects refer to it by a small ID. Objects which have
+*  the same keys in the same order - such as every element of an array of records - share a single shape, which maps a key ID
+*  to the position of that member, so finding a member by key is a lookup of the key followed by a lookup in the shape rather
+*  than a search through the object.
+*
+*  Each object and array is hashed as it is closed, from the hashes of its members or elements, so that two values can often
+*  be told apart, and unchanged parts of two documents passed over, without either being looked at again.
+*
+*  Optionally, scalars are also decoded as they are parsed - numbers converted, literals recognised and strings checked for
+*  escapes - so that reading a value later is a check of its type and a load, however many times it is read.
+*
+*  Positions and counts are held in 32 bits, so a table can hold a document of up to 4GB. Each value costs a node of 8 bytes
+*  and each object or array a further 24, so for records of a few fields each, the table is usually smaller than the text it
+*  was parsed from. Decoded scalars add 16 bytes for each value.
+*
+*  A table is immutable once parsed and is shared by reference count between the readers and writers which keep it.
+*  Entries taken from it only point into it, and are valid for as long as one of those lasts.
+*/
+
+
+class JSONNodeTable {
+public:
+
+	static const std::size_t npos = static_cast<std::size_t>(-1);
+
+	//Positions and counts within the table, which are 32 bits wide so that nodes stay small
+	typedef unsigned int Offset;
+	static const Offset none = static_cast<Offset>(-1);
+
+	enum NodeType {
+		ObjectNode,
+		ArrayNode,
+		ScalarNode
+	};
+
+	//What a scalar holds. Anything which isn't a valid JSON scalar, e.g. an unquoted word, is left undecoded.
+	enum ScalarType {
+		UndecodedScalar,
+		NullScalar,
+		BoolScalar,
+		IntegerScalar,
+		DoubleScalar,
+		StringScalar
+	};
+
+	struct Scalar {
+		ScalarType  type;
+		//For strings, whether there are escape sequences to decode. If not, the contents can be used as they are.
+		bool        escaped;
+		union {
+			bool        boolean;
+			json_int    integer;
+			double      number;
+			//For strings, the length of the contents, without the quote marks
+			std::size_t length;
+		};
+	};
+
+	struct Node {
+		//For scalars, the text of the value within values(), [begin, end); unused for objects and arrays
+		Offset   begin;
+		Offset   end;
+		//For members of an object, the ID of the key; none for anything else
+		Offset   key;
+		//For objects and arrays, the index of their first child, whose siblings follow it, and how many there are
+		Offset   children;
+		Offset   childCount;
+		//For objects, the shape they share with every other object with the same keys; none for anything else
+		Offset   shape;
+		NodeType type;
+	};
+
+	//The source is parsed on construction. Per the soft error handling elsewhere, invalid data leaves the table invalid.
+	//Nothing refers to the source once it is parsed, so the string given is emptied to free it as soon as possible.
+	explicit JSONNodeTable(std::string& source, bool decodeScalars = false);
+
+	bool valid() const;
+
+	//The text of every scalar in the document, in the order they appear in it
+	const std::string& values() const;
+	Node node(std::size_t index) const;
+	static std::size_t root();
+
+	//The index of a child of an object or array, or npos if there is no such child
+	std::size_t child(std::size_t parent, std::size_t position) const;
+
+	//The index of the member of an object with the given key, as it appears in the JSON (i.e. escaped), or npos
+	std::size_t member(std::size_t object, const char* key, std::size_t length) const;
+
+	//The ID of a key as it appears in the JSON, or npos if no object has that key
+	std::size_t keyID(const char* key, std::size_t length) const;
+	const std::string& keyName(std::size_t id) const;
+	//The position of a key within a shape, or npos if objects of that shape don't have it
+	std::size_t slot(std::size_t shape, std::size_t keyID) const;
+
+	//The node written out as the text a JSONEntry holds: "key":value for members, the members of an object without their
+	//braces, and the value itself otherwise. There is no whitespace between the values.
+	std::string text(std::size_t index) const;
+	void appendText(std::string& out, std::size_t index) const;
+
+	std::size_t nodeCount() const;
+	std::size_t keyCount() const;
+	std::size_t shapeCount() const;
+	//The bytes the table holds on the heap, to compare with the size of the text it was parsed from
+	std::size_t memoryUsage() const;
+
+	//The decoded value of a node, if the table decodes scalars; null otherwise. Objects and arrays are left undecoded.
+	const Scalar* scalar(std::size_t index) const;
+
+	//Decode a scalar from its text, e.g. -12.5e3 or "Hello". Integers too large for json_int are decoded as doubles.
+	static Scalar decode(const char* text, std::size_t length);
+
+	/*
+	*  The hash of the value of a node as JSONEntry::hash() gives it, which is built up the same way whether from a table or
+	*  from text: a scalar is hashed on its own, with strings decoded and marked apart from other values, and an object or
+	*  array from the hashes of its members or elements in turn. The key of a member isn't part of it, and an object of one
+	*  member which isn't a member itself is hashed as that member's value, as the text of such an entry reads the same.
+	*/
+	std::size_t hash(std::size_t index) const;
+	static std::size_t scalarHash(const char* text, std::size_t length);
+	static std::size_t containerHash(NodeType type);
+	static std::size_t memberHash(const char* key, std::size_t length, std::size_t valueHash);
+	static std::size_t addHash(std::size_t containerHash, std::size_t childHash);
+
+	//Whether the values of two nodes are the same, ignoring the keys of the nodes themselves but not of their members.
+	//The hashes of objects and arrays are compared first, so values which differ are usually told apart straight away.
+	static bool equal(const JSONNodeTable& lhs, std::size_t lhsIndex, const JSONNodeTable& rhs, std::size_t rhsIndex);
+
+	//Tables are shared, and deleted by whoever releases the last reference
+	void addReference() const;
+	bool release() const;
+
+	//A reference held for as long as the holder lasts, for anything which keeps entries which must outlive their reader
+	class Reference {
+	public:
+		explicit Reference(const JSONNodeTable* table = 0);
+		Reference(const Reference& other);
+		Reference& operator=(const Reference& other);
+		~Reference();
+
+	private:
+		const JSONNodeTable* m_table;
+	};
+
+private:
+
+	struct Shape {
+		std::vector<Offset>      keys;
+		//From the ID of a key to its position in the shape
+		JSONKeyIndex             slots;
+	};
+
+	//As a node is stored: where a scalar's text starts in m_values, or which container an object or array is, along with
+	//the ID of its key, whose top two bits hold the type of the node
+	struct PackedNode {
+		Offset data;
+		Offset keyAndType;
+	};
+	static const Offset keyBits = 30;
+	static const Offset keyMask = (1u << keyBits) - 1;
+
+	struct Container {
+		Offset      children;
+		Offset      childCount;
+		Offset      shape;
+		std::size_t hash;
+	};
+
+	//An object or array which the parser is still inside, and where its children start on the stack of pending children
+	struct OpenContainer {
+		PackedNode node;
+		Offset     firstPending;
+	};
+
+	//The text of every scalar, one after another. Strings end with their closing quote mark, and anything else is followed by
+	//a comma, so that each one can be told apart from the next.
+	std::string                 m_values;
+	//The root is the first node. After it, the children of each object and array are kept together in the order they are in
+	//the source.
+	std::vector<PackedNode>     m_nodes;
+	std::vector<Container>      m_containers;
+	//When scalars are decoded, the decoded value of every node, by index
+	std::vector<Scalar>         m_scalars;
+	bool                        m_decodeScalars;
+
+	std::vector<std::string>    m_keys;
+	JSONKeyIndex                m_keyIndex;
+
+	std::vector<Shape>          m_shapes;
+	//From the hash of a sequence of key IDs to the shapes with that hash
+	JSONKeyIndex                m_shapeIndex;
+
+	bool                        m_valid;
+	mutable JSONAtomicCount     m_references;
+
+	bool parse(const std::string& source);
+	std::size_t internKey(const char* key, std::size_t length);
+	Offset internShape(const std::vector<Offset>& keys);
+	static std::size_t skipWhitespace(const std::string& source, std::size_t pos);
+	NodeType nodeType(std::size_t index) const;
+	//The hash of a node's value alone, without its key
+	std::size_t valueHash(std::size_t index) const;
+
+	JSONNodeTable(const JSONNodeTable&);
+	JSONNodeTable& operator=(const JSONNodeTable&);
+};
+
+#endif
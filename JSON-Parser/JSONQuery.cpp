@@ -0,0 +1,195 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "JSONQuery.h"
+#include "JSONNodeTable.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+namespace {
+
+	std::size_t skipSpaces(const std::string& query, std::size_t pos){
+		while(pos < query.length() && query[pos] == ' ') ++pos;
+		return pos;
+	}
+
+	//Read a key starting at pos, either in quote marks or up to the next character which ends a key. Bare keys have any
+	//spaces around them trimmed.
+	bool readKey(const std::string& query, std::size_t& pos, std::string& key){
+		pos = skipSpaces(query, pos);
+		if(pos < query.length() && query[pos] == '\"'){
+			std::size_t closing = findEndOfString(query, pos);
+			if(closing >= query.length() || query[closing] != '\"') return false;
+			key = unescapeString(query.substr(pos + 1, closing - pos - 1));
+			pos = skipSpaces(query, closing + 1);
+			return true;
+		}
+
+		std::size_t end = std::min(query.find_first_of(".[]{},=", pos), query.length());
+		key = trim(query.substr(pos, end - pos), " ");
+		pos = end;
+		return !key.empty();
+	}
+
+	//Read a JSON scalar, e.g. "Lee" or 12, up to the closing bracket of a filter
+	bool readValue(const std::string& query, std::size_t& pos, std::string& value){
+		pos = skipSpaces(query, pos);
+		std::size_t end;
+		if(pos < query.length() && query[pos] == '\"'){
+			end = findEndOfString(query, pos) + 1;
+			if(end > query.length() || query[end - 1] != '\"') return false;
+		}
+		else end = std::min(query.find_first_of(" ]", pos), query.length());
+
+		value = query.substr(pos, end - pos);
+		pos = skipSpaces(query, end);
+		return JSONNodeTable::decode(value.c_str(), value.length()).type != JSONNodeTable::UndecodedScalar;
+	}
+
+	bool isDigit(char c){
+		return c >= '0' && c <= '9';
+	}
+
+}
+
+JSONQuery::JSONQuery(const std::string& query) : m_valid(false) {
+	m_valid = parse(query);
+	if(!m_valid){
+		m_steps.clear();
+		m_fields.clear();
+	}
+}
+
+bool JSONQuery::valid() const{
+	return m_valid;
+}
+
+bool JSONQuery::operator!() const{
+	return !this->valid();
+}
+
+std::size_t JSONQuery::fieldCount() const{
+	return m_fields.empty() ? 1 : m_fields.size();
+}
+
+bool JSONQuery::parse(const std::string& query){
+	std::size_t pos = 0;
+	while(pos < query.length()){
+		Step step;
+		step.index = 0;
+
+		if(query[pos] == '['){
+			pos = skipSpaces(query, pos + 1);
+			if(pos < query.length() && query[pos] == '*'){
+				step.kind = Step::Wildcard;
+				pos = skipSpaces(query, pos + 1);
+			}
+			else if(pos < query.length() && query[pos] == '?'){
+				step.kind = Step::Wildcard;
+				++pos;
+				if(!readKey(query, pos, step.key) || query.compare(pos, 2, "==") != 0) return false;
+				pos += 2;
+				if(!readValue(query, pos, step.value)) return false;
+			}
+			else if(pos < query.length() && isDigit(query[pos])){
+				step.kind = Step::Index;
+				step.index = std::strtoul(query.c_str() + pos, NULL, 10);
+				while(pos < query.length() && isDigit(query[pos])) ++pos;
+				pos = skipSpaces(query, pos);
+			}
+			else return false;
+
+			if(pos >= query.length() || query[pos] != ']') return false;
+			++pos;
+			m_steps.push_back(step);
+			continue;
+		}
+
+		//Keys follow a dot, other than the first
+		if(!m_steps.empty()){
+			if(query[pos] != '.') return false;
+			++pos;
+		}
+
+		if(pos < query.length() && query[pos] == '{'){
+			++pos;
+			do{
+				std::string field;
+				if(!readKey(query, pos, field)) return false;
+				m_fields.push_back(field);
+			} while(pos < query.length() && query[pos++] == ',');
+			//The list of fields is the end of the query
+			return pos == query.length() && query[pos - 1] == '}' && !m_steps.empty();
+		}
+
+		step.kind = Step::Member;
+		if(!readKey(query, pos, step.key)) return false;
+		m_steps.push_back(step);
+	}
+	return !m_steps.empty();
+}
+
+std::vector<JSONEntry> JSONQuery::select(const JSONReader& source) const{
+	std::vector<JSONEntry> out;
+	if(!m_valid || !source) return out;
+
+	//The first step is taken on the reader, and everything after it on the entries it gives us
+	const Step& first = m_steps[0];
+	bool members = !source.m_document->rootArray;
+	if(first.kind == Step::Member) run(source[first.key], true, 1, out);
+	else if(first.kind == Step::Index) run(source[first.index], members, 1, out);
+	else{
+		//A reader's indices are in order of key for an object, so its elements are taken in the order they are in the data
+		std::vector<JSONEntry> elements;
+		source.elements(elements);
+		JSONEntry wanted(first.value);
+		for(std::size_t i = 0; i < elements.size(); ++i){
+			if(!first.value.empty() && elements[i].directMember(first.key, members) != wanted) continue;
+			run(elements[i], members, 1, out);
+		}
+	}
+	return out;
+}
+
+std::vector<JSONEntry> JSONQuery::select(const JSONEntry& source) const{
+	std::vector<JSONEntry> out;
+	if(m_valid) run(source, source.isMember(), 0, out);
+	return out;
+}
+
+void JSONQuery::run(const JSONEntry& entry, bool member, std::size_t step, std::vector<JSONEntry>& out) const{
+	if(!entry) return;
+	if(step == m_steps.size()){
+		addFields(entry, member, out);
+		return;
+	}
+
+	const Step& current = m_steps[step];
+	if(current.kind == Step::Member) run(entry.directMember(current.key, member), true, step + 1, out);
+	else if(current.kind == Step::Index) run(entry[current.index], !entry.isArray(), step + 1, out);
+	else{
+		std::vector<JSONEntry> elements;
+		entry.elements(elements);
+		//The elements of an object are its members, so keys are looked for in their values
+		bool members = entry.isObject();
+		JSONEntry wanted(current.value);
+		for(std::size_t i = 0; i < elements.size(); ++i){
+			if(!current.value.empty() && elements[i].directMember(current.key, members) != wanted) continue;
+			run(elements[i], members, step + 1, out);
+		}
+	}
+}
+
+void JSONQuery::addFields(const JSONEntry& match, bool member, std::vector<JSONEntry>& out) const{
+	if(m_fields.empty()){
+		out.push_back(match);
+		return;
+	}
+	for(std::size_t i = 0; i < m_fields.size(); ++i) out.push_back(match.directMember(m_fields[i], member));
+}
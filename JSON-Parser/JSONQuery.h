@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------------
+
+#ifndef JSON_03_QUERY
+#define JSON_03_QUERY
+//---------------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "JSONEntry.h"
+#include "JSONReader.h"
+
+/*
+*  A query which picks values out of every element of an array, in place of a loop over its indices. Each element of the
+*  array is visited once, in a single pass over it, rather than the array being searched again for every index.
+*
+*  Queries are a path of keys separated by dots, where each array along the way may be indexed:
+*	users[*].emailAddress                    - the emailAddress of every user
+*	users[?lastName=="Lee"].emailAddress     - ... of only those users whose lastName is "Lee"
+*	users[*].{firstName, lastName}           - several fields of every user
+*	[*].userId                               - for a file which is an unnamed array
+*	quiz.maths.q1.options[2]                 - a single element
+*  [*] visits every element (or member, of an object), and [?key==value] only those elements with a member equal to the
+*  given JSON value. The filter looks at the element's own members only, for readers of either mode, so a key which is only
+*  found nested deeper within an element doesn't match. A list of fields in braces may only come at the end. Keys which
+*  contain any of .[]{},= or leading or trailing spaces may be given in quote marks, e.g. "first.name", with any quote marks
+*  inside escaped as in JSON.
+*
+*  Per the soft error handling elsewhere, a query which can't be understood is invalid, and returns no results.
+*/
+
+
+class JSONQuery {
+public:
+
+	explicit JSONQuery(const std::string& query);
+
+	bool valid() const;
+	bool operator!() const;
+
+	//The number of values found for each match: the number of fields in braces, or one
+	std::size_t fieldCount() const;
+
+	//The values found, in the order they are in the data. With several fields, the fields of each match are together in the
+	//order they were given, so the values for the nth match start at n * fieldCount(). A field which a match doesn't have
+	//is an invalid entry, so that the fields of every match line up.
+	std::vector<JSONEntry> select(const JSONReader& source) const;
+	std::vector<JSONEntry> select(const JSONEntry& source) const;
+
+	//As above, converted as by JSONEntry::as<T>()
+	template<typename T>
+	std::vector<T> as(const JSONReader& source) const {
+		return convert<T>(select(source));
+	}
+	template<typename T>
+	std::vector<T> as(const JSONEntry& source) const {
+		return convert<T>(select(source));
+	}
+
+private:
+
+	struct Step {
+		enum Kind {
+			Member,
+			Index,
+			Wildcard
+		};
+		Kind        kind;
+		//The key of a member, or for a filtered wildcard the key to filter on
+		std::string key;
+		std::size_t index;
+		//For a filtered wildcard, the JSON value to match
+		std::string value;
+	};
+
+	std::vector<Step>        m_steps;
+	std::vector<std::string> m_fields;
+	bool                     m_valid;
+
+	bool parse(const std::string& query);
+
+	//Run the steps from the given one onwards on an entry, adding whatever they find. Keys are only looked for among an
+	//object's own members, so whether the entry is a member of an object, whose value is the object, is passed along with it.
+	void run(const JSONEntry& entry, bool member, std::size_t step, std::vector<JSONEntry>& out) const;
+	void addFields(const JSONEntry& match, bool member, std::vector<JSONEntry>& out) const;
+
+	template<typename T>
+	static std::vector<T> convert(const std::vector<JSONEntry>& entries) {
+		std::vector<T> out;
+		out.reserve(entries.size());
+		for (std::size_t i = 0; i < entries.size(); ++i) out.push_back(entries[i].as<T>());
+		return out;
+	}
+
+};
+
+#endif
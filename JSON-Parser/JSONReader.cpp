@@ -1,70 +1,348 @@
-#ifndef JSON_03_READER
-#define JSON_03_READER
+//---------------------------------------------------------------------------
 
+#pragma hdrstop
 
-#include <string>
-#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
 
+#include "JSONReader.h"
+#include "JSONIOThread.h"
+#include "JSONValidator.h"
 
-#include "JSONEntry.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
 
-/*
-*   A class to provide *read only* access to JSON data from a file, or from a string.
-*	Access to each element is provided by operator[] and can itself be chained
-*	e.g. Reader["Products"][0]["Product Code"].as<std::string>()
-*	will return a std::string containing the product code of the first element of the Products array
-*/
+JSONReader::JSONReader(const std::string& filePathAndName, unsigned options) : m_document(new Document), m_valid(true) {
+	std::string data;
+	if(!readFile(filePathAndName, data)){
+		m_valid = false;
+		return;
+	}
+	setup(data, options);
+}
+
+bool JSONReader::readFile(const std::string& filePathAndName, std::string& data){
+	std::ifstream in(filePathAndName.c_str(), std::ios_base::in | std::ios_base::binary);
+	if(!in) return false;
+	//The file is read straight into the string which is kept, so it isn't held twice along the way
+	in.seekg(0, std::ios_base::end);
+	std::streamoff size = in.tellg();
+	in.seekg(0, std::ios_base::beg);
+	if(size > 0){
+		data.resize(static_cast<std::size_t>(size));
+		in.read(&data[0], size);
+		data.resize(static_cast<std::size_t>(in.gcount()));
+	}
+	else{
+		std::stringstream contents;
+		contents << in.rdbuf();
+		data = contents.str();
+	}
+	return true;
+}
+
+//Copies share the same document, which is never modified after construction
+JSONReader::JSONReader(const JSONReader& other) : m_document(other.m_document), m_valid(other.m_valid) {
+	m_document->references.increment();
+}
+
+JSONReader& JSONReader::operator=(const JSONReader& other){
+	other.m_document->references.increment();
+	if(m_document->references.decrement() == 0) delete m_document;
+	m_document = other.m_document;
+	m_valid = other.m_valid;
+	return *this;
+}
+
+JSONReader::~JSONReader(){
+	if(m_document->references.decrement() == 0) delete m_document;
+}
+
+JSONReader JSONReader::createFromFile(const std::string& filePathAndName, unsigned options){
+	return JSONReader(filePathAndName, options);
+}
+
+JSONReader JSONReader::createFromString(const std::string& stringData, unsigned options){
+	JSONReader out;
+	std::string data(stringData);
+	out.setup(data, options);
+	return out;
+}
+
+#ifdef JSON_03_CXX11
+std::future<JSONReader> JSONReader::loadAsync(const std::string& filePathAndName, unsigned options){
+	std::shared_ptr<std::promise<JSONReader> > result = std::make_shared<std::promise<JSONReader> >();
+	JSONIOThread::io().post([result, filePathAndName, options]() {
+		try{
+			std::shared_ptr<std::string> data = std::make_shared<std::string>();
+			if(!readFile(filePathAndName, *data)){
+				JSONReader unread;
+				unread.m_valid = false;
+				result->set_value(unread);
+				return;
+			}
+			//The file is parsed on a thread of its own, so the reads and writes queued after this one aren't held up by it
+			JSONIOThread::parser().post([result, data, options]() {
+				try{
+					JSONReader out;
+					out.setup(*data, options);
+					result->set_value(out);
+				}
+				catch(...){
+					result->set_exception(std::current_exception());
+				}
+			});
+		}
+		catch(...){
+			result->set_exception(std::current_exception());
+		}
+	});
+	return result->get_future();
+}
+#endif
+
+namespace {
+
+	//Orders the members of an object by key, as JSONEntry::Compare does for entries
+	struct CompareMembers {
+		const JSONNodeTable* nodes;
 
+		bool operator()(std::size_t lhs, std::size_t rhs) const{
+			const std::string& lhsKey = nodes->keyName(nodes->node(lhs).key);
+			const std::string& rhsKey = nodes->keyName(nodes->node(rhs).key);
+			return std::lexicographical_compare(lhsKey.begin(), lhsKey.end(), rhsKey.begin(), rhsKey.end());
+		}
+	};
 
-class JSONReader {
-public:
+	//Orders positions in a list of entries by the keys of the entries there
+	struct CompareTerms {
+		const std::vector<JSONEntry>* terms;
 
-	//"Normal" construction will be to read from an existing JSON file, so while this shares functionality with one of the
-	//factory functions, a simple and idiomatic way to create these objects is still preferable to have.
-	JSONReader(const std::string& filePathAndName);
+		bool operator()(std::size_t lhs, std::size_t rhs) const{
+			return JSONEntry::Compare()((*terms)[lhs], (*terms)[rhs]);
+		}
+	};
 
-	//As in the entry, we provide a "natural" type to index over with a specific overload of the most common use-case: literals.
-	//Returning by const value is intentional - operator[] can be chained repeatedly but no element which starts off const should be
-	//assignable
-	const JSONEntry operator[](std::size_t index) const;
-	const JSONEntry operator[](int index) const;
+}
 
-	//Conversely to how the Entry works internally, here we have to eat the cost of allocating a string to allow the algorithm to work
-	const JSONEntry operator[](const std::string& index) const;
+void JSONReader::setup(std::string& data, unsigned options){
+	if((options & Validate) && !JSONValidator(data)){
+		m_valid = false;
+		return;
+	}
+
+	if(options & (Indexed | DecodeScalars)){
+		setupNodes(data, (options & DecodeScalars) != 0);
+		return;
+	}
+
+	//We only want to remove the outermost braces here. The trim function would take any nested ones with them.
+	std::size_t start = data.find_first_not_of(" \t\r\n\b");
+	std::size_t end = data.find_last_not_of(" \t\r\n\b");
+	if(start == std::string::npos){
+		m_valid = false;
+		return;
+	}
+
+	//A file which is just an unnamed array is read element by element, and kept in its original order
+	if(data[start] == '[' && data[end] == ']'){
+		m_document->rootArray = true;
+		for(std::size_t elementStart = start + 1; elementStart < end;){
+			std::size_t elementEnd = std::min(findEndOfTerm(data, elementStart), end);
+			std::string element = data.substr(elementStart, elementEnd - elementStart);
+			if(!unwrapElement(element).empty()){
+				m_document->data.push_back(JSONEntry(element));
+				m_document->data.back().hash();
+			}
+			elementStart = elementEnd + 1;
+		}
+		return;
+	}
+
+	if(data[start] != '{' || data[end] != '}'){
+		m_valid = false;
+		return;
+	}
 
-	template<std::size_t N>
-	const JSONEntry operator[](const char(&index)[N]) const {
-		return (*this)[std::string(index)];
+	//Each top level term runs up to the next top level comma, or the closing brace of the whole object
+	for(std::size_t termStart = start + 1; termStart < end;){
+		std::size_t termEnd = std::min(findEndOfTerm(data, termStart), end);
+		std::string term = data.substr(termStart, termEnd - termStart);
+		trim(term, " \t\r\n\b,");
+		if(!term.empty()){
+			m_document->data.push_back(JSONEntry(term));
+			m_document->data.back().hash();
+		}
+		termStart = termEnd + 1;
 	}
 
-	bool valid() const;
-	bool operator!() const;
+	//The terms are sorted by key, so we note first where each one will end up, to be able to give them in their original order
+	std::vector<std::size_t> byKey(m_document->data.size());
+	for(std::size_t i = 0; i < byKey.size(); ++i) byKey[i] = i;
+	CompareTerms byTermKey = { &m_document->data };
+	std::stable_sort(byKey.begin(), byKey.end(), byTermKey);
+	m_document->documentOrder.resize(byKey.size());
+	for(std::size_t i = 0; i < byKey.size(); ++i) m_document->documentOrder[byKey[i]] = i;
 
-	//Factory functions to create from different input
-	static JSONReader createFromFile(const std::string& filePathAndName);
-	static JSONReader createFromString(const std::string& stringData);
+	std::stable_sort(m_document->data.begin(), m_document->data.end(), JSONEntry::Compare());
+}
 
+void JSONReader::setupNodes(std::string& data, bool decodeScalars){
+	JSONNodeTable* nodes = new JSONNodeTable(data, decodeScalars);
+	m_document->nodes = nodes;
+	if(!nodes->valid() || nodes->node(JSONNodeTable::root()).type == JSONNodeTable::ScalarNode){
+		m_valid = false;
+		return;
+	}
 
-private:
+	const JSONNodeTable::Node& root = nodes->node(JSONNodeTable::root());
+	m_document->rootArray = root.type == JSONNodeTable::ArrayNode;
+	if(!m_document->rootArray){
+		for(std::size_t i = 0; i < root.childCount; ++i) m_document->sortedMembers.push_back(nodes->child(JSONNodeTable::root(), i));
+		CompareMembers byKey = { nodes };
+		std::stable_sort(m_document->sortedMembers.begin(), m_document->sortedMembers.end(), byKey);
+	}
+}
 
-	/*
-	*  Potentially counter-intuitively, we use a sorted std::vector of elements to store our data.
-	*  This is for a few reasons - firstly, JSONEntry needs to be aware of the key values used in order to
-	*  facilitate arrays, so a map-like container would require duplication of data.
-	*  Secondly, as data will not be added to the vector after construction, a well-designed sorting and retrieval
-	*  setup can make up for, and potentially outperform, a tree-based container.
-	*  Additionally, it allows O(1) lookup via operator[](std::size_t).
-	*/
-	std::vector<JSONEntry> m_data;
-	bool                   m_valid;
+const std::vector<JSONEntry>& JSONReader::entries(std::vector<JSONEntry>& made) const{
+	if(!m_document->nodes) return m_document->data;
+	for(std::size_t i = 0; ; ++i){
+		JSONEntry entry = (*this)[i];
+		if(!entry) break;
+		made.push_back(entry);
+	}
+	return made;
+}
 
-	//Shared setup for all ctors
-	void setup(const std::string& data);
+void JSONReader::elements(std::vector<JSONEntry>& out) const{
+	if(!m_valid) return;
+	const JSONNodeTable* nodes = m_document->nodes;
+	if(nodes){
+		std::size_t count = nodes->node(JSONNodeTable::root()).childCount;
+		for(std::size_t i = 0; i < count; ++i) out.push_back(JSONEntry(nodes, nodes->child(JSONNodeTable::root(), i)));
+	}
+	else if(m_document->rootArray) out.insert(out.end(), m_document->data.begin(), m_document->data.end());
+	else{
+		for(std::size_t i = 0; i < m_document->documentOrder.size(); ++i) out.push_back(m_document->data[m_document->documentOrder[i]]);
+	}
+}
+
+const JSONEntry JSONReader::operator[](std::size_t index) const{
+	const JSONNodeTable* nodes = m_document->nodes;
+	if(nodes){
+		std::size_t node = JSONNodeTable::npos;
+		if(m_document->rootArray) node = nodes->child(JSONNodeTable::root(), index);
+		else if(index < m_document->sortedMembers.size()) node = m_document->sortedMembers[index];
+		if(node == JSONNodeTable::npos) return JSONEntry(false);
+		return JSONEntry(nodes, node);
+	}
+
+	if(index >= m_document->data.size()) return JSONEntry(false);
+	return m_document->data[index];
+}
+
+const JSONEntry JSONReader::operator[](int index) const{
+	return this->operator[](static_cast<std::size_t>(index));
+}
+
+const JSONEntry JSONReader::operator[](const std::string& index) const{
+	//An unnamed array has no keys to look up
+	if(m_document->rootArray) return JSONEntry(false);
+
+	//Keys are stored as they appear in the JSON, so we look for the escaped form of the key. If the user has entered the
+	//quote marks manually, we take it that they have given us the key as it appears in the JSON.
+	std::string key;
+	if(index.length() > 1 && index[0] == '\"' && index[index.length() - 1] == '\"') key = index.substr(1, index.length() - 2);
+	else key = escapeString(index);
+
+	if(m_document->nodes){
+		std::size_t node = m_document->nodes->member(JSONNodeTable::root(), key.data(), key.length());
+		if(node == JSONNodeTable::npos) return JSONEntry(false);
+		return JSONEntry(m_document->nodes, node);
+	}
+
+	//As the data is sorted, the first match in the index is the same one a binary search for the key would find
+	const JSONKeyIndex& keys = keyIndex();
+	std::size_t hash = hashBytes(key.data(), key.length());
+	for(std::size_t slot = keys.first(hash); slot != JSONKeyIndex::npos; slot = keys.next(hash, slot)){
+		const JSONEntry& candidate = m_document->data[keys.value(slot)];
+		std::pair<std::string::const_iterator, std::string::const_iterator> candidateKey = candidate.key();
+		if(static_cast<std::size_t>(candidateKey.second - candidateKey.first) == key.length()
+			&& std::equal(key.begin(), key.end(), candidateKey.first)){
+			return candidate;
+		}
+	}
+	return JSONEntry(false);
+}
+
+const JSONKeyIndex& JSONReader::keyIndex() const{
+	const JSONKeyIndex* existing = m_document->keyIndex.load();
+	if(existing) return *existing;
+
+	//If several threads race to build the index, one wins and the rest throw their copies away, so nobody waits on a lock
+	const std::vector<JSONEntry>& data = m_document->data;
+	JSONKeyIndex* built = new JSONKeyIndex(data.size());
+	for(std::size_t i = 0; i < data.size(); ++i){
+		std::pair<std::string::const_iterator, std::string::const_iterator> key = data[i].key();
+		built->insert(hashBytes(data[i].m_data.data() + (key.first - data[i].m_data.begin()), key.second - key.first), i);
+	}
+
+	if(m_document->keyIndex.publish(built)) return *built;
+	delete built;
+	return *m_document->keyIndex.load();
+}
+
+std::vector<std::string> diff(const JSONReader& before, const JSONReader& after){
+	std::vector<std::string> changes;
+	if(!before || !after || before.m_document->rootArray != after.m_document->rootArray){
+		if(before.valid() || after.valid()) changes.push_back(std::string());
+		return changes;
+	}
+
+	std::vector<JSONEntry> beforeMade, afterMade;
+	const std::vector<JSONEntry>& beforeData = before.entries(beforeMade);
+	const std::vector<JSONEntry>& afterData = after.entries(afterMade);
+
+	//The elements of unnamed arrays are matched by index
+	if(before.m_document->rootArray){
+		for(std::size_t i = 0; i < std::max(beforeData.size(), afterData.size()); ++i){
+			std::ostringstream index;
+			index << i;
+			if(i >= beforeData.size() || i >= afterData.size()) changes.push_back(index.str());
+			else appendDiff(beforeData[i], afterData[i], index.str(), changes);
+		}
+		return changes;
+	}
+
+	//Otherwise both are sorted by key, so we can walk through them side by side
+	JSONEntry::Compare byKey;
+	std::size_t b = 0;
+	std::size_t a = 0;
+	while(b < beforeData.size() || a < afterData.size()){
+		if(a == afterData.size() || (b < beforeData.size() && byKey(beforeData[b], afterData[a]))){
+			std::pair<std::string::const_iterator, std::string::const_iterator> key = beforeData[b++].key();
+			changes.push_back(unescapeString(std::string(key.first, key.second)));
+		}
+		else if(b == beforeData.size() || byKey(afterData[a], beforeData[b])){
+			std::pair<std::string::const_iterator, std::string::const_iterator> key = afterData[a++].key();
+			changes.push_back(unescapeString(std::string(key.first, key.second)));
+		}
+		else{
+			//The values are compared by hash first, so a changed entry is usually found without its data being looked at.
+			//An unchanged one is still scanned in full to be sure of it.
+			if(beforeData[b] != afterData[a]) appendDiff(beforeData[b], afterData[a], std::string(), changes);
+			++b;
+			++a;
+		}
+	}
+	return changes;
+}
 
-	//We want a private default ctor for two reasons:
-	//1. A default constructed instance would be meaningless as all data is read on construction
-	//2. It allows internal processing from the factory functions to start with a blank slate
-	JSONReader() : m_valid(true) {}
+bool JSONReader::valid() const{
+	return m_valid;
+}
 
-};
-#endif
\ No newline at end of file
+bool JSONReader::operator!() const{
+	return !this->valid();
+}
@@ -5,23 +5,72 @@
 #include <string>
 #include <vector>
 
+#include "JSONConfig.h"
+#ifdef JSON_03_CXX11
+#include <future>
+#endif
+
 
 #include "JSONEntry.h"
+#include "JSONAtomic.h"
+#include "JSONKeyIndex.h"
+#include "JSONNodeTable.h"
 
 /*
 *   A class to provide *read only* access to JSON data from a file, or from a string.
 *	Access to each element is provided by operator[] and can itself be chained
 *	e.g. Reader["Products"][0]["Product Code"].as<std::string>()
 *	will return a std::string containing the product code of the first element of the Products array
+*
+*	Thread safety: once constructed, the parsed document is immutable. Copies of a reader share the same document by reference
+*	count rather than copying it, so handing each thread its own copy is cheap. Any number of threads may call the const member
+*	functions of the same reader, or of copies of it, at the same time - anything built lazily on first use (such as the index
+*	of keys) is published with a single atomic swap, so lookups never take a lock. The JSONEntry objects returned are
+*	independent values, which belong to the thread which requested them.
 */
 
 
+class JSONReader;
+
+//The paths of everything which differs between two documents, as diff() does for two entries. The top level entries are hashed
+//as the documents are parsed, so top level entries which changed are usually found by their hashes alone; unchanged ones are
+//still scanned once to be sure of them.
+std::vector<std::string> diff(const JSONReader& before, const JSONReader& after);
+
+
 class JSONReader {
 public:
 
+	/*
+	*  Options for how the JSON is read, which may be combined with |
+	*  Indexed: the whole document is parsed up front into a table of nodes. Only the values are kept, without the keys or the
+	*  whitespace between them; keys are stored once each, and objects with the same keys share a layout, so that lookups are
+	*  a couple of hash lookups at most and entries hold no text of their own. This takes longer to read, but is much quicker
+	*  to query, especially for large arrays of records, and for records of a few fields each it takes less memory to hold
+	*  than the text of the document. Text taken from it has no whitespace between values. Entries point into the reader's
+	*  data, so they are only valid while the reader or a copy of it is. Lookup by key finds members of the object itself,
+	*  rather than the first match anywhere within it.
+	*  DecodeScalars: as Indexed, which it implies, but with every number, literal and string also decoded as it is parsed, so
+	*  that as<>() and type() need only check the type of the value and load it, rather than convert it from text every time.
+	*  The decoded values cost a further 16 bytes for each value.
+	*  Validate: check the data strictly with a JSONValidator before it is read, so that anything malformed leaves the reader
+	*  invalid rather than being made sense of as far as possible. Use a JSONValidator directly to find out what is wrong.
+	*/
+	enum ReadOptions {
+		Indexed = 1,
+		DecodeScalars = 2,
+		Validate = 4
+	};
+
 	//"Normal" construction will be to read from an existing JSON file, so while this shares functionality with one of the
 	//factory functions, a simple and idiomatic way to create these objects is still preferable to have.
-	JSONReader(const std::string& filePathAndName);
+	//The JSON may either be an object, or an unnamed array e.g. [{"A":1},{"A":2}] whose elements are accessed by index.
+	//Very large arrays like this are better read a piece at a time with a JSONStreamReader.
+	JSONReader(const std::string& filePathAndName, unsigned options = 0);
+
+	JSONReader(const JSONReader& other);
+	JSONReader& operator=(const JSONReader& other);
+	~JSONReader();
 
 	//As in the entry, we provide a "natural" type to index over with a specific overload of the most common use-case: literals.
 	//Returning by const value is intentional - operator[] can be chained repeatedly but no element which starts off const should be
@@ -40,31 +89,80 @@ public:
 	bool valid() const;
 	bool operator!() const;
 
+	friend std::vector<std::string> diff(const JSONReader& before, const JSONReader& after);
+	friend class JSONQuery;
+
 	//Factory functions to create from different input
-	static JSONReader createFromFile(const std::string& filePathAndName);
-	static JSONReader createFromString(const std::string& stringData);
+	static JSONReader createFromFile(const std::string& filePathAndName, unsigned options = 0);
+	static JSONReader createFromString(const std::string& stringData, unsigned options = 0);
 
+#ifdef JSON_03_CXX11
+	//Read a file on the background I/O thread and parse it on another, so the caller isn't held up. The result is the same as
+	//constructing from the file, including an invalid reader if the file could not be read.
+	static std::future<JSONReader> loadAsync(const std::string& filePathAndName, unsigned options = 0);
+#endif
 
-private:
 
-	/*
-	*  Potentially counter-intuitively, we use a sorted std::vector of elements to store our data.
-	*  This is for a few reasons - firstly, JSONEntry needs to be aware of the key values used in order to
-	*  facilitate arrays, so a map-like container would require duplication of data.
-	*  Secondly, as data will not be added to the vector after construction, a well-designed sorting and retrieval
-	*  setup can make up for, and potentially outperform, a tree-based container.
-	*  Additionally, it allows O(1) lookup via operator[](std::size_t).
-	*/
-	std::vector<JSONEntry> m_data;
-	bool                   m_valid;
+private:
 
-	//Shared setup for all ctors
-	void setup(const std::string& data);
+	struct Document {
+		/*
+		*  Potentially counter-intuitively, we use a sorted std::vector of elements to store our data.
+		*  This is for a few reasons - firstly, JSONEntry needs to be aware of the key values used in order to
+		*  facilitate arrays, so a map-like container would require duplication of data.
+		*  Secondly, as data will not be added to the vector after construction, a well-designed sorting and retrieval
+		*  setup can make up for, and potentially outperform, a tree-based container.
+		*  Additionally, it allows O(1) lookup via operator[](std::size_t).
+		*/
+		//Each entry is hashed up front, so that comparing entries never has to write to the shared document.
+		std::vector<JSONEntry> data;
+		//If the JSON is an unnamed array, data holds its elements in their original order rather than sorted by key
+		bool                   rootArray;
+		//Otherwise, where in data each member of the object is, in the order they are in the JSON
+		std::vector<std::size_t> documentOrder;
+
+		//The number of readers sharing this document
+		JSONAtomicCount        references;
+
+		//Hashes of the keys in data, so lookup by key doesn't need to compare against keys along the way.
+		//This is built on the first lookup by key, by whichever thread gets there first.
+		JSONAtomicPointer<const JSONKeyIndex> keyIndex;
+
+		//When the reader is Indexed, the document is held as a node table instead of in data. The members of an object at
+		//the top level are also listed in order of their keys, so that lookup by index works as it does for data.
+		const JSONNodeTable*     nodes;
+		std::vector<std::size_t> sortedMembers;
+
+		Document() : rootArray(false), references(1), nodes(0) {}
+		~Document() {
+			delete keyIndex.load();
+			if(nodes && nodes->release()) delete nodes;
+		}
+
+	private:
+		Document(const Document&);
+		Document& operator=(const Document&);
+	};
+
+	Document* m_document;
+	bool      m_valid;
+
+	//Shared setup for all ctors. An indexed reader keeps the data itself rather than a copy, so the string given is left empty.
+	void setup(std::string& data, unsigned options);
+	void setupNodes(std::string& data, bool decodeScalars);
+	static bool readFile(const std::string& filePathAndName, std::string& data);
+
+	//The top level entries, which for an Indexed reader are made on request
+	const std::vector<JSONEntry>& entries(std::vector<JSONEntry>& made) const;
+	//The top level entries in the order they are in the JSON, rather than in order of their keys
+	void elements(std::vector<JSONEntry>& out) const;
+
+	const JSONKeyIndex& keyIndex() const;
 
 	//We want a private default ctor for two reasons:
 	//1. A default constructed instance would be meaningless as all data is read on construction
 	//2. It allows internal processing from the factory functions to start with a blank slate
-	JSONReader() : m_valid(true) {}
+	JSONReader() : m_document(new Document), m_valid(true) {}
 
 };
 #endif
\ No newline at end of file
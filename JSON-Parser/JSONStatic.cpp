@@ -0,0 +1,514 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "JSONStatic.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+namespace {
+
+	const std::size_t npos = static_cast<std::size_t>(-1);
+
+	JSONEntry::ValueType scalarType(const JSONNodeTable::Scalar& scalar){
+		switch(scalar.type){
+		case JSONNodeTable::NullScalar:    return JSONEntry::NullValue;
+		case JSONNodeTable::BoolScalar:    return JSONEntry::BoolValue;
+		case JSONNodeTable::IntegerScalar: return JSONEntry::IntegerValue;
+		case JSONNodeTable::DoubleScalar:  return JSONEntry::DoubleValue;
+		case JSONNodeTable::StringScalar:  return JSONEntry::StringValue;
+		default:                           return JSONEntry::InvalidValue;
+		}
+	}
+
+	bool isWhitespace(char c){
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\b';
+	}
+
+	bool endsValue(char c){
+		return isWhitespace(c) || c == ',' || c == '}' || c == ']';
+	}
+
+	//How long the escape sequence at the start of the data is, taking the two halves of a surrogate pair together
+	std::size_t escapeLength(const char* data, std::size_t length){
+		if(length < 2 || data[1] != 'u') return std::min<std::size_t>(2, length);
+		if(length >= 12 && (data[2] == 'd' || data[2] == 'D') && std::strchr("89abAB", data[3]) && data[3] != '\0'
+			&& data[6] == '\\' && data[7] == 'u') return 12;
+		return std::min<std::size_t>(6, length);
+	}
+
+}
+
+bool StaticJSONEntry::valid() const{
+	return m_reader != 0;
+}
+
+bool StaticJSONEntry::operator!() const{
+	return !this->valid();
+}
+
+const StaticJSONEntry StaticJSONEntry::operator[](const std::string& key) const{
+	return member(key.data(), key.length());
+}
+
+const StaticJSONEntry StaticJSONEntry::operator[](std::size_t index) const{
+	if(!m_reader) return *this;
+	const StaticJSONReaderBase::Node& node = m_reader->m_nodes[m_node];
+	//As with JSONEntry, a simple value is its own first and only element
+	if(node.type == JSONNodeTable::ScalarNode) return index == 0 ? *this : StaticJSONEntry(0, 0);
+	std::size_t found = m_reader->child(m_node, index);
+	return found == npos ? StaticJSONEntry(0, 0) : StaticJSONEntry(m_reader, found);
+}
+
+const StaticJSONEntry StaticJSONEntry::operator[](int index) const{
+	return this->operator[](static_cast<std::size_t>(index));
+}
+
+const StaticJSONEntry StaticJSONEntry::member(const char* key, std::size_t length) const{
+	if(!m_reader) return *this;
+	std::size_t found = m_reader->member(m_node, key, length);
+	return found == npos ? StaticJSONEntry(0, 0) : StaticJSONEntry(m_reader, found);
+}
+
+JSONEntry::ValueType StaticJSONEntry::type() const{
+	if(!m_reader) return JSONEntry::InvalidValue;
+	const StaticJSONReaderBase::Node& node = m_reader->m_nodes[m_node];
+	if(node.type == JSONNodeTable::ObjectNode) return JSONEntry::ObjectValue;
+	if(node.type == JSONNodeTable::ArrayNode) return JSONEntry::ArrayValue;
+	return scalarType(JSONNodeTable::decode(text(), textLength()));
+}
+
+bool StaticJSONEntry::isNull() const{
+	return type() == JSONEntry::NullValue;
+}
+
+bool StaticJSONEntry::isBool() const{
+	return type() == JSONEntry::BoolValue;
+}
+
+bool StaticJSONEntry::isNumber() const{
+	JSONEntry::ValueType valueType = type();
+	return valueType == JSONEntry::IntegerValue || valueType == JSONEntry::DoubleValue;
+}
+
+bool StaticJSONEntry::isInteger() const{
+	return type() == JSONEntry::IntegerValue;
+}
+
+bool StaticJSONEntry::isString() const{
+	return type() == JSONEntry::StringValue;
+}
+
+bool StaticJSONEntry::isArray() const{
+	return type() == JSONEntry::ArrayValue;
+}
+
+bool StaticJSONEntry::isObject() const{
+	return type() == JSONEntry::ObjectValue;
+}
+
+std::size_t StaticJSONEntry::copyString(char* out, std::size_t capacity) const{
+	if(!m_reader) return 0;
+	const char* value = text();
+	std::size_t length = textLength();
+	if(length >= 2 && value[0] == '\"' && value[length - 1] == '\"') return unescapeInto(out, capacity, value + 1, length - 2);
+	std::memcpy(out, value, std::min(length, capacity));
+	return length;
+}
+
+const char* StaticJSONEntry::text() const{
+	return m_reader->m_source + m_reader->m_nodes[m_node].begin;
+}
+
+std::size_t StaticJSONEntry::textLength() const{
+	const StaticJSONReaderBase::Node& node = m_reader->m_nodes[m_node];
+	return node.end - node.begin;
+}
+
+
+
+StaticJSONReaderBase::StaticJSONReaderBase(char* source, std::size_t sourceCapacity, Node* nodes, std::size_t nodeCapacity)
+	: m_source(source), m_sourceCapacity(sourceCapacity), m_length(0), m_nodes(nodes), m_nodeCapacity(nodeCapacity),
+	m_nodeCount(0), m_valid(false), m_overflowed(false) {}
+
+void StaticJSONReaderBase::load(const char* data, std::size_t length){
+	//The copy is null terminated, which the conversions to numbers rely on
+	if(length >= m_sourceCapacity){
+		m_overflowed = true;
+		return;
+	}
+	std::memcpy(m_source, data, length);
+	m_source[length] = '\0';
+	m_length = length;
+	m_valid = parse() && m_nodes[0].type != JSONNodeTable::ScalarNode;
+}
+
+bool StaticJSONReaderBase::valid() const{
+	return m_valid;
+}
+
+bool StaticJSONReaderBase::operator!() const{
+	return !this->valid();
+}
+
+bool StaticJSONReaderBase::overflowed() const{
+	return m_overflowed;
+}
+
+const StaticJSONEntry StaticJSONReaderBase::operator[](const std::string& key) const{
+	return root()[key];
+}
+
+const StaticJSONEntry StaticJSONReaderBase::operator[](std::size_t index) const{
+	if(!m_valid) return StaticJSONEntry(0, 0);
+	std::size_t found = child(0, index);
+	return found == npos ? StaticJSONEntry(0, 0) : StaticJSONEntry(this, found);
+}
+
+const StaticJSONEntry StaticJSONReaderBase::operator[](int index) const{
+	return this->operator[](static_cast<std::size_t>(index));
+}
+
+const StaticJSONEntry StaticJSONReaderBase::root() const{
+	//As with JSONReader, a file which is an unnamed array has no keys to look up
+	if(!m_valid || m_nodes[0].type != JSONNodeTable::ObjectNode) return StaticJSONEntry(0, 0);
+	return StaticJSONEntry(this, 0);
+}
+
+std::size_t StaticJSONReaderBase::child(std::size_t node, std::size_t position) const{
+	if(m_nodes[node].type == JSONNodeTable::ScalarNode) return npos;
+	for(std::size_t i = node + 1; i < m_nodes[node].next; i = m_nodes[i].next){
+		if(position-- == 0) return i;
+	}
+	return npos;
+}
+
+std::size_t StaticJSONReaderBase::member(std::size_t node, const char* key, std::size_t length) const{
+	const Node& parent = m_nodes[node];
+	if(parent.type == JSONNodeTable::ScalarNode) return npos;
+	for(std::size_t i = node + 1; i < parent.next; i = m_nodes[i].next){
+		if(parent.type == JSONNodeTable::ObjectNode){
+			if(keyMatches(m_nodes[i], key, length)) return i;
+		}
+		//As with text, an array gives us the first of its items with a matching key
+		else if(m_nodes[i].type == JSONNodeTable::ObjectNode){
+			std::size_t found = member(i, key, length);
+			if(found != npos) return found;
+		}
+	}
+	return npos;
+}
+
+bool StaticJSONReaderBase::keyMatches(const Node& node, const char* key, std::size_t length) const{
+	const char* raw = m_source + node.key;
+	std::size_t rawLength = node.keyLength;
+
+	//Keys are matched as they would be decoded, unless the user has entered the quote marks themselves, in which case they
+	//are matched as they appear in the JSON
+	if(length > 1 && key[0] == '\"' && key[length - 1] == '\"'){
+		return rawLength == length - 2 && std::memcmp(raw, key + 1, rawLength) == 0;
+	}
+	if(!std::memchr(raw, '\\', rawLength)) return rawLength == length && std::memcmp(raw, key, length) == 0;
+
+	//Escaped keys are decoded one escape at a time as we go, so no room is needed for the whole of the key
+	std::size_t matched = 0;
+	for(std::size_t i = 0; i < rawLength;){
+		if(raw[i] != '\\'){
+			if(matched == length || key[matched] != raw[i]) return false;
+			++matched;
+			++i;
+			continue;
+		}
+		std::size_t sequence = escapeLength(raw + i, rawLength - i);
+		char decoded[8];
+		std::size_t decodedLength = unescapeInto(decoded, sizeof(decoded), raw + i, sequence);
+		if(decodedLength > length - matched || std::memcmp(key + matched, decoded, decodedLength) != 0) return false;
+		matched += decodedLength;
+		i += sequence;
+	}
+	return matched == length;
+}
+
+std::size_t StaticJSONReaderBase::skipWhitespace(std::size_t pos) const{
+	while(pos < m_length && isWhitespace(m_source[pos])) ++pos;
+	return pos;
+}
+
+std::size_t StaticJSONReaderBase::endOfString(std::size_t openingQuote) const{
+	for(std::size_t i = openingQuote + 1; i < m_length; ++i){
+		if(m_source[i] == '\\') ++i;
+		else if(m_source[i] == '\"') return i;
+	}
+	return npos;
+}
+
+bool StaticJSONReaderBase::parse(){
+	/*
+	*  As JSONNodeTable's parse, a single pass without recursion. Nodes are added in the order they appear, so the children of
+	*  a container are simply the nodes after it up to its next; the containers still open are found through their parents.
+	*/
+	std::size_t open = npos;
+	std::size_t pos = skipWhitespace(0);
+	for(;;){
+		std::size_t key = npos;
+		std::size_t keyLength = npos;
+		if(open != npos && m_nodes[open].type == JSONNodeTable::ObjectNode){
+			if(pos >= m_length || m_source[pos] != '\"') return false;
+			std::size_t keyEnd = endOfString(pos);
+			if(keyEnd == npos) return false;
+			key = pos + 1;
+			keyLength = keyEnd - pos - 1;
+
+			pos = skipWhitespace(keyEnd + 1);
+			if(pos >= m_length || m_source[pos] != ':') return false;
+			pos = skipWhitespace(pos + 1);
+		}
+		if(pos >= m_length) return false;
+
+		if(m_nodeCount == m_nodeCapacity){
+			m_overflowed = true;
+			return false;
+		}
+		std::size_t index = m_nodeCount++;
+		Node& node = m_nodes[index];
+		node.begin = pos;
+		node.key = key;
+		node.keyLength = keyLength;
+		node.parent = open;
+
+		char c = m_source[pos];
+		bool opened = false;
+		if(c == '{' || c == '['){
+			node.type = (c == '{') ? JSONNodeTable::ObjectNode : JSONNodeTable::ArrayNode;
+			open = index;
+			pos = skipWhitespace(pos + 1);
+			opened = true;
+		}
+		else{
+			node.type = JSONNodeTable::ScalarNode;
+			if(c == '\"'){
+				std::size_t closing = endOfString(pos);
+				if(closing == npos) return false;
+				node.end = closing + 1;
+			}
+			else{
+				node.end = pos;
+				while(node.end < m_length && !endsValue(m_source[node.end])) ++node.end;
+				if(node.end == pos) return false;
+			}
+			node.next = index + 1;
+			pos = skipWhitespace(node.end);
+		}
+
+		//Now close as many containers as end here, until we reach a comma which says another value follows
+		for(bool first = true;; first = false){
+			if(open == npos) return pos == m_length;
+			if(pos >= m_length) return false;
+
+			Node& container = m_nodes[open];
+			char closing = (container.type == JSONNodeTable::ObjectNode) ? '}' : ']';
+			if(m_source[pos] == ',' && !(opened && first)){
+				pos = skipWhitespace(pos + 1);
+				break;
+			}
+			if(m_source[pos] != closing){
+				//A freshly opened container with something in it goes straight on to its first value
+				if(opened && first) break;
+				return false;
+			}
+
+			container.end = pos + 1;
+			container.next = m_nodeCount;
+			open = container.parent;
+			pos = skipWhitespace(pos + 1);
+		}
+	}
+}
+
+
+
+StaticJSONWriterBase::StaticJSONWriterBase(char* buffer, std::size_t capacity)
+	: m_buffer(buffer), m_capacity(capacity), m_length(0), m_depth(0), m_arrayDepth(0), m_anyTerms(false), m_valid(true),
+	m_overflowed(false) {
+	put("{\n", 2);
+}
+
+void StaticJSONWriterBase::add(const StaticJSONEntry& entry){
+	if(!entry) return;
+	const StaticJSONReaderBase::Node& node = entry.m_reader->m_nodes[entry.m_node];
+	//As with JSONWriter, a member is copied from its key onwards, exactly as it is in the source
+	std::size_t begin = (node.keyLength != npos) ? node.key - 1 : node.begin;
+	beginTerm(entry.m_reader->m_source[begin]);
+	put(entry.m_reader->m_source + begin, node.end - begin);
+}
+
+void StaticJSONWriterBase::addPreEscaped(const char* key, const char* value){
+	if(!beginMember(key, std::strlen(key))) return;
+	put('\"');
+	put(value, std::strlen(value));
+	put('\"');
+}
+
+void StaticJSONWriterBase::addPreEscaped(const std::string& key, const std::string& value){
+	if(!beginMember(key.data(), key.length())) return;
+	put('\"');
+	put(value.data(), value.length());
+	put('\"');
+}
+
+void StaticJSONWriterBase::startArray(const char* key){
+	if(!beginMember(key, std::strlen(key))) return;
+	put('[');
+	++m_depth;
+	++m_arrayDepth;
+}
+
+void StaticJSONWriterBase::startArray(const std::string& key){
+	if(!beginMember(key.data(), key.length())) return;
+	put('[');
+	++m_depth;
+	++m_arrayDepth;
+}
+
+void StaticJSONWriterBase::endArray(){
+	if(m_arrayDepth == 0 || !m_anyTerms) return;
+	//As with JSONWriter, the bracket closes the last term unless that was the end of an array item
+	if(lastChar() == '}') beginTerm(']');
+	put(']');
+	--m_depth;
+	--m_arrayDepth;
+}
+
+void StaticJSONWriterBase::startArrayItem(){
+	beginTerm('{');
+	put('{');
+	++m_depth;
+}
+
+void StaticJSONWriterBase::endArrayItem(){
+	beginTerm('}');
+	put('}');
+	if(m_depth > 0) --m_depth;
+}
+
+bool StaticJSONWriterBase::valid() const{
+	return m_valid;
+}
+
+bool StaticJSONWriterBase::operator!() const{
+	return !this->valid();
+}
+
+bool StaticJSONWriterBase::overflowed() const{
+	return m_overflowed;
+}
+
+const char* StaticJSONWriterBase::c_str() const{
+	if(!m_valid) return "";
+	//The closing brace goes in the room kept for it, so the writer can carry on from where it was
+	const char* closing = m_anyTerms ? "\n}\n" : "}\n";
+	std::strcpy(m_buffer + m_length, closing);
+	return m_buffer;
+}
+
+std::size_t StaticJSONWriterBase::length() const{
+	if(!m_valid) return 0;
+	return m_length + (m_anyTerms ? 3 : 2);
+}
+
+std::string StaticJSONWriterBase::getString(bool removeWS) const{
+	const char* data = c_str();
+	std::string out;
+	out.reserve(length());
+	for(; *data != '\0'; ++data){
+		//NB: As with JSONWriter, spaces are kept, as they may be part of the data
+		if(removeWS && (*data == '\n' || *data == '\t' || *data == '\r' || *data == '\b')) continue;
+		out += *data;
+	}
+	return out;
+}
+
+bool StaticJSONWriterBase::room(std::size_t length){
+	if(!m_valid) return false;
+	if(m_capacity < closingLength || length > m_capacity - closingLength - m_length){
+		m_valid = false;
+		m_overflowed = true;
+		return false;
+	}
+	return true;
+}
+
+void StaticJSONWriterBase::put(char c){
+	if(room(1)) m_buffer[m_length++] = c;
+}
+
+void StaticJSONWriterBase::put(const char* data, std::size_t length){
+	if(!room(length)) return;
+	std::memcpy(m_buffer + m_length, data, length);
+	m_length += length;
+}
+
+void StaticJSONWriterBase::putQuoted(const char* data, std::size_t length){
+	put('\"');
+	putEscaped(data, length);
+	put('\"');
+}
+
+void StaticJSONWriterBase::putEscaped(const char* data, std::size_t length){
+	if(!room(0)) return;
+	std::size_t available = m_capacity - closingLength - m_length;
+	std::size_t escaped = escapeInto(m_buffer + m_length, available, data, length);
+	if(room(escaped)) m_length += escaped;
+}
+
+//As with JSONWriter, C++03 has no snprintf, but each buffer here is comfortably larger than anything the format can produce.
+//The formats are the same as JSONWriter's, so numbers are written identically.
+void StaticJSONWriterBase::putNumber(long value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	put(buffer, std::sprintf(buffer, "%ld", value));
+}
+
+void StaticJSONWriterBase::putNumber(unsigned long value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	put(buffer, std::sprintf(buffer, "%lu", value));
+}
+
+void StaticJSONWriterBase::putNumber(double value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	put(buffer, std::sprintf(buffer, "%g", value));
+}
+
+void StaticJSONWriterBase::putNumber(long double value){
+	char buffer[64];
+#pragma warning(suppress : 4996)
+	put(buffer, std::sprintf(buffer, "%Lg", value));
+}
+
+char StaticJSONWriterBase::lastChar() const{
+	return m_length > 0 ? m_buffer[m_length - 1] : '\0';
+}
+
+void StaticJSONWriterBase::beginTerm(char first){
+	if(m_anyTerms){
+		char last = lastChar();
+		if(last != '{' && last != '[' && first != '}' && first != ']') put(',');
+		put('\n');
+	}
+	for(std::size_t i = 0; i < m_depth; ++i) put('\t');
+	m_anyTerms = true;
+}
+
+bool StaticJSONWriterBase::beginMember(const char* key, std::size_t length){
+	beginTerm('\"');
+	putQuoted(key, length);
+	put(':');
+	return m_valid;
+}
@@ -0,0 +1,440 @@
+//---------------------------------------------------------------------------
+
+#ifndef JSON_03_STATIC
+#define JSON_03_STATIC
+//---------------------------------------------------------------------------
+
+#include <string>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include "Tags.h"
+#include "JSONString.h"
+#include "JSONEntry.h"
+#include "JSONNodeTable.h"
+
+/*
+*  Variants of JSONReader and JSONWriter for code which can't allocate at all. All of their storage is inside the object
+*  itself, with its size set by template arguments, so they can live on the stack or in memory set aside up front:
+*
+*	StaticJSONReader<4096, 256> in(message, messageLength);
+*	int id = in["users"][0]["userId"].as<int>();
+*
+*	StaticJSONWriter<4096> out;
+*	out.add("userId", id);
+*	send(out.c_str(), out.length());
+*
+*  Data which doesn't fit - more than MaxBytes of text, or more than MaxNodes values - leaves them invalid, and overflowed()
+*  tells that apart from data which is malformed. Nothing is written once a writer has overflowed.
+*
+*  Otherwise they are used as JSONReader and JSONWriter are, and write exactly the same text, with a few differences which
+*  come of not allocating:
+*  - Entries refer to the reader they came from, which must outlive them, rather than sharing its data
+*  - Lookup by key searches the members of an object in turn, which for the small messages these are meant for is quicker
+*    than any index, and lookup by index on the reader itself is by position in the file rather than in order of key
+*  - Anything which returns a std::string, such as as<std::string>() and getString(), allocates as it always has;
+*    copyString() and c_str() are the equivalents which don't
+*  - They can't be copied, as their storage is a part of them
+*/
+
+
+class StaticJSONReaderBase;
+class StaticJSONWriterBase;
+
+class StaticJSONEntry {
+public:
+
+	bool valid() const;
+	bool operator!() const;
+
+	//As for JSONEntry, lookups on an array find the first of its items with a matching key
+	template<std::size_t N>
+	const StaticJSONEntry operator[](const char(&key)[N]) const {
+		return member(key, std::char_traits<char>::length(key));
+	}
+	const StaticJSONEntry operator[](const std::string& key) const;
+	const StaticJSONEntry operator[](std::size_t index) const;
+	const StaticJSONEntry operator[](int index) const;
+
+	JSONEntry::ValueType type() const;
+	bool isNull() const;
+	bool isBool() const;
+	bool isNumber() const;
+	bool isInteger() const;
+	bool isString() const;
+	bool isArray() const;
+	bool isObject() const;
+
+	template<typename T>
+	T as() const {
+		if (!valid()) return as_helper<T>::get("N/A", 3, instance_of<T>());
+		return as_helper<T>::get(text(), textLength(), instance_of<T>());
+	}
+
+	//A string decoded into a buffer, or the text of any other value. As with snprintf, the return value is the full length,
+	//and if that is more than the capacity only what fits is written. Nothing is null terminated.
+	std::size_t copyString(char* out, std::size_t capacity) const;
+
+private:
+
+	const StaticJSONReaderBase* m_reader;
+	std::size_t                 m_node;
+
+	StaticJSONEntry(const StaticJSONReaderBase* reader, std::size_t node) : m_reader(reader), m_node(node) {}
+
+	friend class StaticJSONReaderBase;
+	friend class StaticJSONWriterBase;
+
+	const StaticJSONEntry member(const char* key, std::size_t length) const;
+	//The value as it is in the source, e.g. with the quote marks and any escapes of a string
+	const char* text() const;
+	std::size_t textLength() const;
+
+	//The same conversions as JSONEntry::as_helper, working on the text in place
+	template<typename T>
+	struct as_helper {
+
+		static inline T get(const char* text, std::size_t length, tag_std_string) {
+			if (length < 2 || text[0] != '\"' || text[length - 1] != '\"') return T(text, text + length);
+			std::string decoded;
+			appendUnescaped(decoded, text + 1, length - 2);
+			return T(decoded.begin(), decoded.end());
+		}
+
+#ifdef __TCPLUSPLUS__
+		static inline T get(const char* text, std::size_t length, tag_delphi_string) {
+			return decodeStringValue(std::string(text, length)).c_str();
+		}
+#endif
+
+		//The source always ends in a null, and every number is followed by something which isn't part of one, so the C
+		//library conversions stop where they should
+		static inline T get(const char* text, std::size_t, tag_floating_point) {
+			return static_cast<T>(std::atof(skipQuote(text)));
+		}
+
+		static inline T get(const char* text, std::size_t, tag_signed_int) {
+			return static_cast<T>(std::atol(skipQuote(text)));
+		}
+
+		static inline T get(const char* text, std::size_t, tag_unsigned_int) {
+			return static_cast<T>(std::strtoul(skipQuote(text), NULL, 10));
+		}
+
+		static inline T get(const char* text, std::size_t, instance_of<bool>) {
+			switch (skipQuote(text)[0]) {
+			case 't':
+			case 'T':
+			case '1':
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		static inline T get(const char* text, std::size_t length, tag_char) {
+			char first = '0';
+			if (length >= 2 && text[0] == '\"' && text[length - 1] == '\"') {
+				char decoded[4];
+				if (unescapeInto(decoded, sizeof(decoded), text + 1, length - 2) > 0) first = decoded[0];
+			}
+			else if (length > 0) first = text[0];
+			return static_cast<T>(first);
+		}
+
+		static inline const char* skipQuote(const char* text) {
+			return (*text == '\"') ? text + 1 : text;
+		}
+
+	};
+
+};
+
+
+
+//The parts of StaticJSONReader which don't depend on its capacities, working on the storage it is given
+class StaticJSONReaderBase {
+public:
+
+	bool valid() const;
+	bool operator!() const;
+	//Whether the data was too large for the reader, rather than malformed
+	bool overflowed() const;
+
+	template<std::size_t N>
+	const StaticJSONEntry operator[](const char(&key)[N]) const {
+		return root()[key];
+	}
+	const StaticJSONEntry operator[](const std::string& key) const;
+	const StaticJSONEntry operator[](std::size_t index) const;
+	const StaticJSONEntry operator[](int index) const;
+
+	/*
+	*  The source is kept with the nodes in document order, each one knowing where the node after all of its children is,
+	*  so that the children of any node can be walked without any list of them being kept.
+	*/
+	struct Node {
+		//The text of the value within the source, [begin, end)
+		std::size_t begin;
+		std::size_t end;
+		//For members of an object, the key as it is in the source without its quote marks; keyLength is npos for anything else
+		std::size_t key;
+		std::size_t keyLength;
+		//The node which follows this one and all of its children
+		std::size_t next;
+		std::size_t parent;
+		JSONNodeTable::NodeType type;
+	};
+
+protected:
+
+	StaticJSONReaderBase(char* source, std::size_t sourceCapacity, Node* nodes, std::size_t nodeCapacity);
+	void load(const char* data, std::size_t length);
+
+private:
+
+	friend class StaticJSONEntry;
+	friend class StaticJSONWriterBase;
+
+	char*       m_source;
+	std::size_t m_sourceCapacity;
+	std::size_t m_length;
+	Node*       m_nodes;
+	std::size_t m_nodeCapacity;
+	std::size_t m_nodeCount;
+	bool        m_valid;
+	bool        m_overflowed;
+
+	const StaticJSONEntry root() const;
+	std::size_t child(std::size_t node, std::size_t position) const;
+	std::size_t member(std::size_t node, const char* key, std::size_t length) const;
+	bool keyMatches(const Node& node, const char* key, std::size_t length) const;
+
+	bool parse();
+	std::size_t skipWhitespace(std::size_t pos) const;
+	std::size_t endOfString(std::size_t openingQuote) const;
+
+	StaticJSONReaderBase(const StaticJSONReaderBase&);
+	StaticJSONReaderBase& operator=(const StaticJSONReaderBase&);
+};
+
+
+//MaxBytes is the largest data the reader can hold, and MaxNodes the most values - every object, array, member and element
+template<std::size_t MaxBytes, std::size_t MaxNodes>
+class StaticJSONReader : public StaticJSONReaderBase {
+public:
+
+	StaticJSONReader(const char* data, std::size_t length) : StaticJSONReaderBase(m_sourceStorage, MaxBytes, m_nodeStorage, MaxNodes) {
+		load(data, length);
+	}
+	explicit StaticJSONReader(const std::string& data) : StaticJSONReaderBase(m_sourceStorage, MaxBytes, m_nodeStorage, MaxNodes) {
+		load(data.data(), data.length());
+	}
+
+private:
+
+	char m_sourceStorage[MaxBytes];
+	Node m_nodeStorage[MaxNodes];
+
+};
+
+
+
+//The parts of StaticJSONWriter which don't depend on its capacity, writing into the buffer it is given
+class StaticJSONWriterBase {
+public:
+
+	template<typename T>
+	void add(const char* key, const T& value) {
+		if (!beginMember(key, std::strlen(key))) return;
+		write_helper<T>::write(*this, value, instance_of<T>());
+	}
+	template<typename T>
+	void add(const std::string& key, const T& value) {
+		if (!beginMember(key.data(), key.length())) return;
+		write_helper<T>::write(*this, value, instance_of<T>());
+	}
+
+	//An entry of a StaticJSONReader, copied as it is in the source
+	void add(const StaticJSONEntry& entry);
+
+	void addPreEscaped(const char* key, const char* value);
+	void addPreEscaped(const std::string& key, const std::string& value);
+
+	void startArray(const char* key);
+	void startArray(const std::string& key);
+	void endArray();
+
+	template<typename T>
+	void addSimpleArrayItem(const T& item) {
+		if (m_arrayDepth == 0 || !m_anyTerms) return;
+		if (lastChar() != '[') put(',');
+		write_helper<T>::write(*this, item, instance_of<T>());
+	}
+
+	void startArrayItem();
+	void endArrayItem();
+
+	bool valid() const;
+	bool operator!() const;
+	//Whether the writer ran out of room, rather than being used incorrectly
+	bool overflowed() const;
+
+	//The JSON as JSONWriter::getString() would give it, without any allocation. This is empty if the writer is invalid.
+	const char* c_str() const;
+	std::size_t length() const;
+	std::string getString(bool removeWS = false) const;
+
+protected:
+
+	explicit StaticJSONWriterBase(char* buffer, std::size_t capacity);
+
+private:
+
+	char*       m_buffer;
+	std::size_t m_capacity;
+	std::size_t m_length;
+	std::size_t m_depth;
+	std::size_t m_arrayDepth;
+	bool        m_anyTerms;
+	bool        m_valid;
+	bool        m_overflowed;
+
+	//Room is always kept for the closing brace and a null, which c_str() adds without changing the length
+	static const std::size_t closingLength = 4;
+
+	bool room(std::size_t length);
+	void put(char c);
+	void put(const char* data, std::size_t length);
+	void putQuoted(const char* data, std::size_t length);
+	template<typename Iterator>
+	void putQuoted(Iterator first, Iterator last) {
+		//Wide strings are narrowed a block at a time
+		char block[64];
+		put('\"');
+		while (first != last && m_valid) {
+			std::size_t count = 0;
+			for (; first != last && count < sizeof(block); ++first) block[count++] = static_cast<char>(*first);
+			putEscaped(block, count);
+		}
+		put('\"');
+	}
+	void putEscaped(const char* data, std::size_t length);
+	void putNumber(long value);
+	void putNumber(unsigned long value);
+	void putNumber(double value);
+	void putNumber(long double value);
+
+	char lastChar() const;
+	//Start a new term of the output, finishing the one before it as JSONWriter formats them: one to a line, indented
+	//by how deeply it is nested, and followed by a comma if it isn't opening or closing anything
+	void beginTerm(char first);
+	bool beginMember(const char* key, std::size_t length);
+
+	StaticJSONWriterBase(const StaticJSONWriterBase&);
+	StaticJSONWriterBase& operator=(const StaticJSONWriterBase&);
+
+	//The same types as JSONWriter::add_helper, written straight into the buffer
+	template<typename T>
+	struct write_helper {
+
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<std::string>) {
+			out.putQuoted(in.data(), in.length());
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_std_string) {
+			out.putQuoted(in.begin(), in.end());
+		}
+		template<std::size_t N>
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<char[N]>) {
+			out.putQuoted(in, std::char_traits<char>::length(in));
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<const char*>) {
+			out.putQuoted(in, std::strlen(in));
+		}
+
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_signed_int) {
+			out.putNumber(static_cast<long>(in));
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_unsigned_int) {
+			out.putNumber(static_cast<unsigned long>(in));
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_floating_point) {
+			out.putNumber(static_cast<double>(in));
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<long double>) {
+			out.putNumber(in);
+		}
+
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<char>) {
+			out.putQuoted(&in, 1);
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, instance_of<bool>) {
+			if (in) out.put("true", 4);
+			else out.put("false", 5);
+		}
+
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_sequence) {
+			writeRange(out, beginOf(in), endOf(in));
+		}
+		static inline void write(StaticJSONWriterBase& out, const T& in, tag_string_map) {
+			typedef typename T::mapped_type mapped_type;
+			out.put('{');
+			for (typename T::const_iterator it = in.begin(); it != in.end(); ++it) {
+				if (it != in.begin()) out.put(',');
+				out.putQuoted(it->first.data(), it->first.length());
+				out.put(':');
+				write_helper<mapped_type>::write(out, it->second, instance_of<mapped_type>());
+			}
+			out.put('}');
+		}
+
+	};
+
+	template<typename Iterator>
+	static void writeRange(StaticJSONWriterBase& out, Iterator first, Iterator last) {
+		typedef typename std::iterator_traits<Iterator>::value_type value_type;
+		out.put('[');
+		for (Iterator it = first; it != last; ++it) {
+			if (it != first) out.put(',');
+			write_helper<value_type>::write(out, *it, instance_of<value_type>());
+		}
+		out.put(']');
+	}
+
+	//Built-in arrays have no begin() and end() of their own
+	template<typename C>
+	static typename C::const_iterator beginOf(const C& in) {
+		return in.begin();
+	}
+	template<typename C>
+	static typename C::const_iterator endOf(const C& in) {
+		return in.end();
+	}
+	template<typename U, std::size_t N>
+	static const U* beginOf(const U (&in)[N]) {
+		return in;
+	}
+	template<typename U, std::size_t N>
+	static const U* endOf(const U (&in)[N]) {
+		return in + N;
+	}
+
+};
+
+
+//MaxBytes is the most the writer can hold, including the closing brace and a null
+template<std::size_t MaxBytes>
+class StaticJSONWriter : public StaticJSONWriterBase {
+public:
+
+	StaticJSONWriter() : StaticJSONWriterBase(m_storage, MaxBytes) {}
+
+private:
+
+	char m_storage[MaxBytes];
+
+};
+
+#endif
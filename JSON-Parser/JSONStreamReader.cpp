@@ -0,0 +1,135 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "JSONStreamReader.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+JSONStreamReader::JSONStreamReader(const std::string& filePathAndName, std::size_t chunkSize)
+	: m_file(filePathAndName.c_str(), std::ios_base::in | std::ios_base::binary), m_source(&m_file),
+	m_chunkSize(chunkSize == 0 ? 1 : chunkSize), m_pos(0), m_count(0), m_started(false), m_atEnd(false), m_valid(true) {
+	if(!m_file) m_valid = false;
+}
+
+JSONStreamReader::JSONStreamReader(std::istream& source, std::size_t chunkSize)
+	: m_source(&source), m_chunkSize(chunkSize == 0 ? 1 : chunkSize), m_pos(0), m_count(0),
+	m_started(false), m_atEnd(false), m_valid(true) {
+	if(!source) m_valid = false;
+}
+
+const JSONEntry JSONStreamReader::next(){
+	if(!m_valid || m_atEnd) return JSONEntry(false);
+
+	if(!m_started){
+		if(!skipWhitespace() || m_buffer[m_pos] != '['){
+			m_valid = false;
+			return JSONEntry(false);
+		}
+		++m_pos;
+		m_started = true;
+	}
+
+	//Every element after the first will follow a comma, unless we've reached the end of the array
+	if(!skipWhitespace()){
+		m_valid = false;
+		return JSONEntry(false);
+	}
+	if(m_buffer[m_pos] == ']'){
+		m_atEnd = true;
+		return JSONEntry(false);
+	}
+	if(m_count > 0){
+		if(m_buffer[m_pos] != ','){
+			m_valid = false;
+			return JSONEntry(false);
+		}
+		++m_pos;
+		if(!skipWhitespace()){
+			m_valid = false;
+			return JSONEntry(false);
+		}
+	}
+
+	//Now find the end of the element, which is the next comma or closing bracket which isn't nested inside it.
+	//Every time we run out of data we read another chunk; since that discards everything before the start of this element
+	//we need to keep our position relative to the start of the element.
+	std::size_t braceDepth = 0;
+	bool inString = false;
+	bool escaped = false;
+	for(std::size_t i = m_pos;; ++i){
+		if(i == m_buffer.length()){
+			std::size_t scanned = i - m_pos;
+			if(!readChunk()){
+				m_valid = false;
+				return JSONEntry(false);
+			}
+			i = m_pos + scanned;
+		}
+
+		char c = m_buffer[i];
+		if(inString){
+			if(escaped) escaped = false;
+			else if(c == '\\') escaped = true;
+			else if(c == '\"') inString = false;
+		}
+		else if(c == '\"') inString = true;
+		else if(c == '{' || c == '[') ++braceDepth;
+		else if(braceDepth > 0 && (c == '}' || c == ']')) --braceDepth;
+		else if(braceDepth == 0 && (c == ',' || c == ']' || c == '}')){
+			if(c == '}') break;
+
+			std::string element = m_buffer.substr(m_pos, i - m_pos);
+			m_pos = i;
+			if(unwrapElement(element).empty()) break;
+
+			++m_count;
+			return JSONEntry(element);
+		}
+	}
+
+	//We only get here on a malformed element, e.g. [1,,2]
+	m_valid = false;
+	return JSONEntry(false);
+}
+
+bool JSONStreamReader::readChunk(){
+	m_buffer.erase(0, m_pos);
+	m_pos = 0;
+
+	std::size_t oldLength = m_buffer.length();
+	m_buffer.resize(oldLength + m_chunkSize);
+	m_source->read(&m_buffer[oldLength], static_cast<std::streamsize>(m_chunkSize));
+	std::size_t bytesRead = static_cast<std::size_t>(m_source->gcount());
+	m_buffer.resize(oldLength + bytesRead);
+
+	return bytesRead > 0;
+}
+
+bool JSONStreamReader::skipWhitespace(){
+	for(;;){
+		while(m_pos < m_buffer.length()){
+			char c = m_buffer[m_pos];
+			if(c != ' ' && c != '\t' && c != '\r' && c != '\n') return true;
+			++m_pos;
+		}
+		if(!readChunk()) return false;
+	}
+}
+
+std::size_t JSONStreamReader::count() const{
+	return m_count;
+}
+
+bool JSONStreamReader::atEnd() const{
+	return m_atEnd;
+}
+
+bool JSONStreamReader::valid() const{
+	return m_valid;
+}
+
+bool JSONStreamReader::operator!() const{
+	return !this->valid();
+}
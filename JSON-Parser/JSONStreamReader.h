@@ -0,0 +1,70 @@
+#ifndef JSON_03_STREAM_READER
+#define JSON_03_STREAM_READER
+
+
+#include <string>
+#include <istream>
+#include <fstream>
+
+
+#include "JSONEntry.h"
+
+/*
+*	A class to read a JSON file which is one large unnamed array, e.g. [{"A":1},{"A":2}, ...], one element at a time.
+*	Rather than reading the whole file up front as JSONReader does, the file is read in chunks as the elements are requested,
+*	so memory use is in proportion to the largest element rather than to the file.
+*	e.g.
+*	JSONStreamReader bulk("Export.json");
+*	for(JSONEntry item = bulk.next(); item.valid(); item = bulk.next()){
+*		int id = item["ID"].as<int>();
+*	}
+*/
+
+
+class JSONStreamReader {
+public:
+
+	//As with JSONReader, reading from a file is the normal use, but any input stream can be read from.
+	//In the latter case the stream is not owned by this class, and must outlive it.
+	explicit JSONStreamReader(const std::string& filePathAndName, std::size_t chunkSize = 65536);
+	explicit JSONStreamReader(std::istream& source, std::size_t chunkSize = 65536);
+
+	//Pull the next element out of the array. Once the end of the array is reached, or in the event of invalid data,
+	//this returns an invalid entry.
+	const JSONEntry next();
+
+	//The number of elements read so far
+	std::size_t count() const;
+
+	bool atEnd() const;
+	bool valid() const;
+	bool operator!() const;
+
+private:
+
+	std::ifstream m_file;
+	std::istream* m_source;
+	std::size_t   m_chunkSize;
+
+	//The data read so far which has not yet been returned as an element, along with where we are in it.
+	std::string   m_buffer;
+	std::size_t   m_pos;
+
+	std::size_t   m_count;
+	bool          m_started;
+	bool          m_atEnd;
+	bool          m_valid;
+
+	//Read another chunk into the buffer, discarding the data before m_pos which is no longer needed.
+	//Returns false if there is no more data to read.
+	bool readChunk();
+
+	//Move m_pos to the next character which is not whitespace, reading more data as needed
+	bool skipWhitespace();
+
+	//Not copyable, as the position in the stream cannot be shared
+	JSONStreamReader(const JSONStreamReader&);
+	JSONStreamReader& operator=(const JSONStreamReader&);
+
+};
+#endif
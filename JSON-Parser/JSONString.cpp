@@ -0,0 +1,371 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <cstring>
+#include <algorithm>
+
+#include "JSONString.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_03_SSE2
+#include <emmintrin.h>
+#endif
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+namespace {
+
+	/*
+	*  Word-at-a-time helpers, for platforms without SSE2. These use the classic bit tricks to test every byte in a word at once:
+	*  (x - 0x0101..) & ~x & 0x8080.. is non-zero exactly when x contains a zero byte, and by xor-ing against a repeated byte we
+	*  can test for any particular value. We use unsigned long as C++03 has no fixed-width types, and build the constants from it
+	*  so this works for whatever width it happens to be.
+	*/
+	typedef unsigned long word_type;
+
+	const word_type lowBits = ~static_cast<word_type>(0) / 255;
+	const word_type highBits = lowBits * 0x80;
+
+	inline word_type loadWord(const char* data) {
+		word_type word;
+		std::memcpy(&word, data, sizeof(word));
+		return word;
+	}
+
+	inline word_type hasZeroByte(word_type word) {
+		return (word - lowBits) & ~word & highBits;
+	}
+
+	inline word_type hasByte(word_type word, unsigned char c) {
+		return hasZeroByte(word ^ (lowBits * c));
+	}
+
+	inline word_type hasByteBelow(word_type word, unsigned char c) {
+		return (word - lowBits * c) & ~word & highBits;
+	}
+
+	inline bool needsEscape(unsigned char c) {
+		return c < 0x20 || c == '\"' || c == '\\';
+	}
+
+	//Position of the first backslash at or after startPos, or length if there are none
+	std::size_t findBackslash(const char* data, std::size_t length, std::size_t startPos) {
+		std::size_t i = startPos;
+#ifdef JSON_03_SSE2
+		const __m128i backslash = _mm_set1_epi8('\\');
+		for (; i + 16 <= length; i += 16) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, backslash)) != 0) break;
+		}
+#else
+		for (; i + sizeof(word_type) <= length; i += sizeof(word_type)) {
+			if (hasByte(loadWord(data + i), '\\')) break;
+		}
+#endif
+		const void* found = std::memchr(data + i, '\\', length - i);
+		return found ? static_cast<const char*>(found) - data : length;
+	}
+
+	//A fixed-size buffer with just enough of the interface of std::string for the routines below, so that they can write into
+	//either. Anything past the capacity is counted but not written, so the size is always the length the result needs.
+	class FixedBuffer {
+	public:
+		FixedBuffer(char* data, std::size_t capacity) : m_data(data), m_capacity(capacity), m_size(0) {}
+
+		void append(const char* data, std::size_t length) {
+			if (m_size < m_capacity) std::memcpy(m_data + m_size, data, std::min(length, m_capacity - m_size));
+			m_size += length;
+		}
+		FixedBuffer& operator+=(char c) {
+			if (m_size < m_capacity) m_data[m_size] = c;
+			++m_size;
+			return *this;
+		}
+		FixedBuffer& operator+=(const char* text) {
+			append(text, std::strlen(text));
+			return *this;
+		}
+		void reserve(std::size_t) {}
+		std::size_t size() const {
+			return m_size;
+		}
+
+	private:
+		char*       m_data;
+		std::size_t m_capacity;
+		std::size_t m_size;
+	};
+
+	//Code points are written out as UTF-8
+	template<typename Out>
+	void appendCodePoint(Out& out, unsigned long codePoint) {
+		if (codePoint < 0x80) {
+			out += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800) {
+			out += static_cast<char>(0xC0 | (codePoint >> 6));
+			out += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000) {
+			out += static_cast<char>(0xE0 | (codePoint >> 12));
+			out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (codePoint >> 18));
+			out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	//Read the four hex digits of a \uXXXX escape starting at data[pos]. Returns false if they are not all there.
+	bool readHex4(const char* data, std::size_t length, std::size_t pos, unsigned long& result) {
+		if (pos + 4 > length) return false;
+		result = 0;
+		for (std::size_t i = pos; i < pos + 4; ++i) {
+			char c = data[i];
+			result <<= 4;
+			if (c >= '0' && c <= '9') result |= c - '0';
+			else if (c >= 'a' && c <= 'f') result |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') result |= c - 'A' + 10;
+			else return false;
+		}
+		return true;
+	}
+
+	const unsigned long replacementChar = 0xFFFD;
+
+}
+
+std::size_t findCharToEscape(const char* data, std::size_t length, std::size_t startPos) {
+	std::size_t i = startPos;
+#ifdef JSON_03_SSE2
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i lastControl = _mm_set1_epi8(0x1F);
+	for (; i + 16 <= length; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		//SSE2 only has signed byte comparison, so we find bytes <= 0x1F as those which are unchanged by an unsigned max with 0x1F
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+			_mm_cmpeq_epi8(_mm_max_epu8(block, lastControl), lastControl));
+		if (_mm_movemask_epi8(special) != 0) break;
+	}
+#else
+	for (; i + sizeof(word_type) <= length; i += sizeof(word_type)) {
+		word_type word = loadWord(data + i);
+		if (hasByteBelow(word, 0x20) | hasByte(word, '\"') | hasByte(word, '\\')) break;
+	}
+#endif
+	//Either we found a block with something of interest in it, or we are on the tail end of the data
+	for (; i < length; ++i) {
+		if (needsEscape(static_cast<unsigned char>(data[i]))) return i;
+	}
+	return length;
+}
+
+namespace {
+
+	template<typename Out>
+	void escapeTo(Out& out, const char* data, std::size_t length) {
+		std::size_t runStart = 0;
+		std::size_t next = findCharToEscape(data, length);
+
+		//The no-escape fast path - which will be the majority of strings
+		if (next == length) {
+			out.append(data, length);
+			return;
+		}
+
+		static const char hexDigits[] = "0123456789abcdef";
+		//Most escapes are two characters, so we leave a little room for them
+		out.reserve(out.size() + length + 8);
+		while (next < length) {
+			out.append(data + runStart, next - runStart);
+
+			unsigned char c = static_cast<unsigned char>(data[next]);
+			switch (c) {
+			case '\"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				out += "\\u00";
+				out += hexDigits[c >> 4];
+				out += hexDigits[c & 0xF];
+			}
+
+			runStart = next + 1;
+			next = findCharToEscape(data, length, runStart);
+		}
+		out.append(data + runStart, length - runStart);
+	}
+
+}
+
+void appendEscaped(std::string& out, const char* data, std::size_t length) {
+	escapeTo(out, data, length);
+}
+
+std::size_t escapeInto(char* out, std::size_t capacity, const char* data, std::size_t length) {
+	FixedBuffer buffer(out, capacity);
+	escapeTo(buffer, data, length);
+	return buffer.size();
+}
+
+std::string escapeString(const std::string& toEscape) {
+	std::string out;
+	appendEscaped(out, toEscape.data(), toEscape.length());
+	return out;
+}
+
+namespace {
+
+	template<typename Out>
+	bool unescapeTo(Out& out, const char* data, std::size_t length) {
+		std::size_t runStart = 0;
+		std::size_t next = findBackslash(data, length, 0);
+		if (next == length) {
+			out.append(data, length);
+			return true;
+		}
+
+		bool wellFormed = true;
+		out.reserve(out.size() + length);
+		while (next < length) {
+			out.append(data + runStart, next - runStart);
+
+			//A lone backslash at the very end has nothing to escape
+			if (next + 1 >= length) {
+				wellFormed = false;
+				runStart = length;
+				break;
+			}
+
+			std::size_t escapeLength = 2;
+			switch (data[next + 1]) {
+			case '\"': out += '\"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				unsigned long codePoint;
+				if (!readHex4(data, length, next + 2, codePoint)) {
+					wellFormed = false;
+					appendCodePoint(out, replacementChar);
+					break;
+				}
+				escapeLength = 6;
+
+				//Characters outside the BMP are escaped as a UTF-16 surrogate pair, e.g. \uD83D\uDE00, so we need both halves
+				if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+					unsigned long lowSurrogate;
+					if (next + 7 < length && data[next + 6] == '\\' && data[next + 7] == 'u'
+						&& readHex4(data, length, next + 8, lowSurrogate)
+						&& lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF) {
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+						escapeLength = 12;
+					}
+					else {
+						wellFormed = false;
+						codePoint = replacementChar;
+					}
+				}
+				else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+					wellFormed = false;
+					codePoint = replacementChar;
+				}
+				appendCodePoint(out, codePoint);
+				break;
+			}
+			default:
+				//Not a valid escape, so we keep the character and note the error
+				wellFormed = false;
+				out += data[next + 1];
+			}
+
+			runStart = next + escapeLength;
+			next = findBackslash(data, length, runStart);
+		}
+		if (runStart < length) out.append(data + runStart, length - runStart);
+		return wellFormed;
+	}
+
+}
+
+bool appendUnescaped(std::string& out, const char* data, std::size_t length) {
+	return unescapeTo(out, data, length);
+}
+
+std::size_t unescapeInto(char* out, std::size_t capacity, const char* data, std::size_t length) {
+	FixedBuffer buffer(out, capacity);
+	unescapeTo(buffer, data, length);
+	return buffer.size();
+}
+
+std::string unescapeString(const std::string& toUnescape) {
+	std::string out;
+	appendUnescaped(out, toUnescape.data(), toUnescape.length());
+	return out;
+}
+
+bool validUTF8(const char* data, std::size_t length) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	std::size_t i = 0;
+	while (i < length) {
+		//Skip over runs of plain ASCII a block at a time
+#ifdef JSON_03_SSE2
+		while (i + 16 <= length && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) == 0) i += 16;
+#else
+		while (i + sizeof(word_type) <= length && (loadWord(data + i) & highBits) == 0) i += sizeof(word_type);
+#endif
+		if (i >= length) break;
+
+		unsigned char lead = bytes[i];
+		if (lead < 0x80) {
+			++i;
+			continue;
+		}
+
+		//Work out how many continuation bytes to expect, and the valid range of the first of them. Restricting that range
+		//is what rules out overlong encodings, UTF-16 surrogates and anything past U+10FFFF.
+		std::size_t continuations;
+		unsigned char low = 0x80, high = 0xBF;
+		if (lead >= 0xC2 && lead <= 0xDF) continuations = 1;
+		else if (lead == 0xE0) { continuations = 2; low = 0xA0; }
+		else if (lead == 0xED) { continuations = 2; high = 0x9F; }
+		else if (lead >= 0xE1 && lead <= 0xEF) continuations = 2;
+		else if (lead == 0xF0) { continuations = 3; low = 0x90; }
+		else if (lead == 0xF4) { continuations = 3; high = 0x8F; }
+		else if (lead >= 0xF1 && lead <= 0xF3) continuations = 3;
+		else return false;
+
+		if (i + continuations >= length) return false;
+		if (bytes[i + 1] < low || bytes[i + 1] > high) return false;
+		for (std::size_t j = 2; j <= continuations; ++j) {
+			if ((bytes[i + j] & 0xC0) != 0x80) return false;
+		}
+		i += continuations + 1;
+	}
+	return true;
+}
+
+bool validUTF8(const std::string& data) {
+	return validUTF8(data.data(), data.length());
+}
+
+std::string decodeStringValue(const std::string& value) {
+	if (value.length() < 2 || value[0] != '\"' || value[value.length() - 1] != '\"') return value;
+	std::string out;
+	appendUnescaped(out, value.data() + 1, value.length() - 2);
+	return out;
+}
@@ -0,0 +1,48 @@
+//---------------------------------------------------------------------------
+
+#ifndef JSON_03_STRING
+#define JSON_03_STRING
+//---------------------------------------------------------------------------
+
+#include <string>
+#include <cstddef>
+
+/*
+*  Routines for moving text in and out of JSON string literals.
+*  The common case by far is a string with nothing in it that needs escaping, so all of these scan in blocks for the handful of
+*  "interesting" bytes (quotes, backslashes, control characters, non-ASCII) and copy any clean run between them in one go.
+*  Where SSE2 is available we scan 16 bytes at a time; otherwise we fall back to scanning a machine word at a time, which keeps
+*  the code within C++03 and free of any dependencies.
+*/
+
+
+//Returns the position of the first character at or after startPos which must be escaped in a JSON string (", \ or a control
+//character), or length if there are none.
+std::size_t findCharToEscape(const char* data, std::size_t length, std::size_t startPos = 0);
+
+//Append the data to out as the contents of a JSON string literal (the surrounding quotes are not added), escaping as required.
+void appendEscaped(std::string& out, const char* data, std::size_t length);
+std::string escapeString(const std::string& toEscape);
+
+//Decode the contents of a JSON string literal (without its surrounding quotes), including \uXXXX escapes and surrogate pairs,
+//into UTF-8. Per the soft error handling approach elsewhere, malformed escapes are decoded as best we can (with U+FFFD for
+//any broken code points) and the return value is false.
+bool appendUnescaped(std::string& out, const char* data, std::size_t length);
+std::string unescapeString(const std::string& toUnescape);
+
+//As appendEscaped and appendUnescaped, but into a fixed buffer rather than a string, for code which mustn't allocate. As with
+//snprintf, the return value is the full length of the result; if that is more than the capacity, only what fits is written.
+std::size_t escapeInto(char* out, std::size_t capacity, const char* data, std::size_t length);
+std::size_t unescapeInto(char* out, std::size_t capacity, const char* data, std::size_t length);
+
+//Check whether the data is well-formed UTF-8 per RFC 3629 (so no overlong forms, surrogates or code points past U+10FFFF)
+bool validUTF8(const char* data, std::size_t length);
+bool validUTF8(const std::string& data);
+
+//Given a JSON value as text, e.g. "Say \"Hi\"", return it as the user would want to see it - quoted strings are unquoted and
+//decoded, anything else is returned as-is.
+std::string decodeStringValue(const std::string& value);
+
+
+
+#endif
@@ -0,0 +1,241 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <cstring>
+#include <algorithm>
+
+#include "JSONValidator.h"
+#include "JSONString.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+namespace {
+
+	bool isDigit(char c){
+		return c >= '0' && c <= '9';
+	}
+
+	bool isHexDigit(char c){
+		return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	}
+
+	//The offset of the first malformed sequence in some data which we already know isn't valid UTF-8. This is only needed
+	//once an error has been found, so it checks one sequence at a time rather than in blocks.
+	std::size_t firstInvalidUTF8(const char* data, std::size_t length){
+		std::size_t i = 0;
+		while(i < length){
+			unsigned char lead = static_cast<unsigned char>(data[i]);
+			std::size_t sequence = 1;
+			if(lead >= 0xF0) sequence = 4;
+			else if(lead >= 0xE0) sequence = 3;
+			else if(lead >= 0xC0) sequence = 2;
+			sequence = std::min(sequence, length - i);
+			if(!validUTF8(data + i, sequence)) return i;
+			i += sequence;
+		}
+		return length;
+	}
+
+}
+
+JSONValidator::JSONValidator(const char* begin, const char* end, std::size_t maxDepth, std::size_t maxSize)
+	: m_data(begin), m_length(end - begin), m_maxDepth(maxDepth), m_errorOffset(npos), m_error("") {
+	validate(maxSize);
+}
+
+JSONValidator::JSONValidator(const std::string& data, std::size_t maxDepth, std::size_t maxSize)
+	: m_data(data.data()), m_length(data.length()), m_maxDepth(maxDepth), m_errorOffset(npos), m_error("") {
+	validate(maxSize);
+}
+
+bool JSONValidator::valid() const{
+	return m_errorOffset == npos;
+}
+
+bool JSONValidator::operator!() const{
+	return !this->valid();
+}
+
+std::size_t JSONValidator::errorOffset() const{
+	return m_errorOffset;
+}
+
+const char* JSONValidator::error() const{
+	return m_error;
+}
+
+bool JSONValidator::fail(std::size_t offset, const char* error){
+	m_errorOffset = offset;
+	m_error = error;
+	return false;
+}
+
+std::size_t JSONValidator::skipWhitespace(std::size_t pos) const{
+	//Only the four whitespace characters the RFC allows
+	while(pos < m_length && (m_data[pos] == ' ' || m_data[pos] == '\n' || m_data[pos] == '\r' || m_data[pos] == '\t')) ++pos;
+	return pos;
+}
+
+bool JSONValidator::validate(std::size_t maxSize){
+	if(m_length > maxSize) return fail(maxSize, "Data is larger than the maximum size");
+
+	/*
+	*  What we expect to see next. Values may be anything; the First states are straight after an opening brace or bracket,
+	*  where the container may also close; after a value, we expect a comma or the end of the container we are in.
+	*/
+	enum State {
+		Value,
+		FirstValue,
+		Key,
+		FirstKey,
+		Colon,
+		AfterValue
+	};
+
+	State state = Value;
+	std::size_t pos = 0;
+	for(;;){
+		pos = skipWhitespace(pos);
+		if(pos == m_length){
+			if(state == AfterValue && m_open.empty()) return true;
+			return fail(pos, "Unexpected end of data");
+		}
+
+		char c = m_data[pos];
+		switch(state){
+		case FirstKey:
+			if(c == '}'){
+				m_open.pop_back();
+				++pos;
+				state = AfterValue;
+				break;
+			}
+			//Falls through - otherwise this is the same as any other key
+		case Key:
+			if(c != '\"') return fail(pos, "Expected a key");
+			if(!checkString(pos)) return false;
+			state = Colon;
+			break;
+
+		case Colon:
+			if(c != ':') return fail(pos, "Expected ':' after key");
+			++pos;
+			state = Value;
+			break;
+
+		case FirstValue:
+			if(c == ']'){
+				m_open.pop_back();
+				++pos;
+				state = AfterValue;
+				break;
+			}
+			//Falls through - otherwise this is the same as any other value
+		case Value:
+			switch(c){
+			case '{':
+			case '[':
+				if(m_open.size() >= m_maxDepth) return fail(pos, "Nesting is deeper than the maximum depth");
+				m_open.push_back(c);
+				++pos;
+				state = (c == '{') ? FirstKey : FirstValue;
+				continue;
+			case '\"':
+				if(!checkString(pos)) return false;
+				break;
+			case 't':
+				if(!checkLiteral(pos, "true", 4)) return false;
+				break;
+			case 'f':
+				if(!checkLiteral(pos, "false", 5)) return false;
+				break;
+			case 'n':
+				if(!checkLiteral(pos, "null", 4)) return false;
+				break;
+			default:
+				if(c != '-' && !isDigit(c)) return fail(pos, "Expected a value");
+				if(!checkNumber(pos)) return false;
+			}
+			state = AfterValue;
+			break;
+
+		case AfterValue:
+			if(m_open.empty()) return fail(pos, "Unexpected data after the end of the document");
+			if(c == ','){
+				++pos;
+				state = (m_open.back() == '{') ? Key : Value;
+			}
+			else if(m_open.back() == '{'){
+				if(c != '}') return fail(pos, "Expected ',' or '}'");
+				m_open.pop_back();
+				++pos;
+			}
+			else{
+				if(c != ']') return fail(pos, "Expected ',' or ']'");
+				m_open.pop_back();
+				++pos;
+			}
+			break;
+		}
+	}
+}
+
+bool JSONValidator::checkString(std::size_t& pos){
+	std::size_t opening = pos;
+	++pos;
+	for(;;){
+		//Everything up to the next quote, backslash or control character is skipped in blocks, and need only be valid UTF-8
+		std::size_t special = findCharToEscape(m_data, m_length, pos);
+		if(!validUTF8(m_data + pos, special - pos)){
+			return fail(pos + firstInvalidUTF8(m_data + pos, special - pos), "Invalid UTF-8 in string");
+		}
+		if(special == m_length) return fail(opening, "Unterminated string");
+
+		pos = special;
+		char c = m_data[pos];
+		if(c == '\"'){
+			++pos;
+			return true;
+		}
+		if(c != '\\') return fail(pos, "Unescaped control character in string");
+
+		if(pos + 1 == m_length) return fail(opening, "Unterminated string");
+		c = m_data[pos + 1];
+		if(c == 'u'){
+			for(std::size_t i = pos + 2; i < pos + 6; ++i){
+				if(i >= m_length || !isHexDigit(m_data[i])) return fail(pos, "Invalid \\u escape in string");
+			}
+			pos += 6;
+		}
+		else if(c != '\0' && std::strchr("\"\\/bfnrt", c)) pos += 2;
+		else return fail(pos, "Invalid escape sequence in string");
+	}
+}
+
+bool JSONValidator::checkNumber(std::size_t& pos){
+	//Per the grammar in the RFC: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	if(m_data[pos] == '-') ++pos;
+	if(pos == m_length || !isDigit(m_data[pos])) return fail(pos, "Expected a digit");
+	//Leading zeroes are not allowed, which is caught by whatever follows the zero not being a comma or the like
+	if(m_data[pos] == '0') ++pos;
+	else while(pos < m_length && isDigit(m_data[pos])) ++pos;
+
+	if(pos < m_length && m_data[pos] == '.'){
+		if(++pos == m_length || !isDigit(m_data[pos])) return fail(pos, "Expected a digit after the decimal point");
+		while(pos < m_length && isDigit(m_data[pos])) ++pos;
+	}
+	if(pos < m_length && (m_data[pos] == 'e' || m_data[pos] == 'E')){
+		if(++pos < m_length && (m_data[pos] == '+' || m_data[pos] == '-')) ++pos;
+		if(pos == m_length || !isDigit(m_data[pos])) return fail(pos, "Expected a digit in the exponent");
+		while(pos < m_length && isDigit(m_data[pos])) ++pos;
+	}
+	return true;
+}
+
+bool JSONValidator::checkLiteral(std::size_t& pos, const char* literal, std::size_t length){
+	if(m_length - pos < length || std::memcmp(m_data + pos, literal, length) != 0) return fail(pos, "Invalid literal");
+	pos += length;
+	return true;
+}
@@ -0,0 +1,66 @@
+//---------------------------------------------------------------------------
+
+#ifndef JSON_03_VALIDATOR
+#define JSON_03_VALIDATOR
+//---------------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/*
+*  A strict check of whether some data is JSON per RFC 8259, for putting in front of anything which reads data from a source
+*  we don't trust. The readers are deliberately forgiving, and will make what they can of malformed data; this will not, and
+*  rejects it before any of the cost of parsing it is paid.
+*
+*  Strings are checked for correct escapes and for valid UTF-8, numbers against the grammar in the RFC, and the nesting of
+*  objects and arrays is limited to a maximum depth, so that a hostile document can't make the reader work arbitrarily hard.
+*  The check is a single pass with no recursion and no allocation beyond the stack of open containers, and the contents of
+*  strings are skipped over in blocks with the same scanning JSONString.h uses.
+*
+*  Per the soft error handling elsewhere, the result is queried with valid(), and the first error found is reported by its
+*  byte offset into the data and a description of what is wrong there.
+*/
+
+
+class JSONValidator {
+public:
+
+	static const std::size_t npos = static_cast<std::size_t>(-1);
+	static const std::size_t defaultMaxDepth = 512;
+
+	//The data, [begin, end), is checked on construction. A maximum size of npos allows data of any size.
+	JSONValidator(const char* begin, const char* end, std::size_t maxDepth = defaultMaxDepth, std::size_t maxSize = npos);
+	explicit JSONValidator(const std::string& data, std::size_t maxDepth = defaultMaxDepth, std::size_t maxSize = npos);
+
+	bool valid() const;
+	bool operator!() const;
+
+	//The byte offset of the first error and what it is; npos and an empty string if the data is valid
+	std::size_t errorOffset() const;
+	const char* error() const;
+
+private:
+
+	const char*       m_data;
+	std::size_t       m_length;
+	std::size_t       m_maxDepth;
+
+	std::size_t       m_errorOffset;
+	const char*       m_error;
+
+	//The objects and arrays we are currently inside, by their opening character
+	std::vector<char> m_open;
+
+	bool validate(std::size_t maxSize);
+	bool fail(std::size_t offset, const char* error);
+
+	std::size_t skipWhitespace(std::size_t pos) const;
+	//Each of these checks the value starting at pos, and on success moves pos past it
+	bool checkString(std::size_t& pos);
+	bool checkNumber(std::size_t& pos);
+	bool checkLiteral(std::size_t& pos, const char* literal, std::size_t length);
+
+};
+
+#endif
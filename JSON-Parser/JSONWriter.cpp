@@ -1,41 +1,86 @@
 //---------------------------------------------------------------------------
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 
 
 #include "JSONWriter.h"
+#include "JSONIOThread.h"
+#ifdef JSON_03_CXX11
+#include <memory>
+#endif
 //---------------------------------------------------------------------------
 
 
 
 void JSONWriter::add(const JSONEntry& input){
+	//Entries from an indexed reader are added as text, as the writer changes its terms in place
+	if(input.m_table) m_data.push_back(JSONEntry(input.text()));
+	else m_data.push_back(input);
+	indexMember(m_data.size() - 1);
+}
+
+void JSONWriter::splice(const JSONEntry& input, SpliceFormat format){
+	if(!input.m_table){
+		add(input);
+		return;
+	}
 	m_data.push_back(input);
+	//The entry only points into its reader's table, so the writer keeps the table alive for as long as it needs it
+	Splice splice = { m_data.size() - 1, format, JSONNodeTable::Reference(input.m_table) };
+	m_splices.push_back(splice);
+	indexMember(m_data.size() - 1);
+}
+
+void JSONWriter::addPreEscaped(const std::string& key, const std::string& value){
+	std::string term = quotedKey(key);
+	term.reserve(term.length() + value.length() + 2);
+	term += '\"';
+	term += value;
+	term += '\"';
+	m_data.push_back(JSONEntry(term));
+	indexMember(m_data.size() - 1);
 }
 
 void JSONWriter::startArray(const std::string& key){
-	m_data.push_back(JSONEntry("\"" + key +"\":["));
+	m_data.push_back(JSONEntry(quotedKey(key) + "["));
+	openScope(indexMember(m_data.size() - 1));
 	++m_arrayDepth;
 }
 
 void JSONWriter::endArray(){
 	if(m_arrayDepth == 0 || m_data.empty()) return;
 
+	//Spliced terms aren't changed, so the bracket goes on a line of its own as it does after an array item
+	if(m_data[m_data.size() - 1].m_table){
+		m_data.push_back(JSONEntry("]"));
+		closeScope();
+		--m_arrayDepth;
+		return;
+	}
+
 	std::string& mostRecentTerm = m_data[m_data.size() - 1].m_data;
 	std::size_t lastTokenIndex = mostRecentTerm.find_last_not_of(" \t\n\r\b");
 
 	if(lastTokenIndex == std::string::npos) return;
-	if(mostRecentTerm[lastTokenIndex] != '}') mostRecentTerm += "]";
+	if(mostRecentTerm[lastTokenIndex] != '}'){
+		mostRecentTerm += "]";
+		m_data[m_data.size() - 1].m_hashed = false;
+	}
 	else m_data.push_back(JSONEntry("]"));
 
+	closeScope();
 	--m_arrayDepth;
 }
 
 void JSONWriter::startArrayItem(){
 	m_data.push_back(JSONEntry("{"));
+	openScope(indexArrayItem(m_data.size() - 1));
 }
 
 void JSONWriter::endArrayItem(){
 	m_data.push_back(JSONEntry("}"));
+	closeScope();
 }
 
 JSONEntry& JSONWriter::operator[](std::size_t index){
@@ -46,7 +91,37 @@ JSONEntry& JSONWriter::operator[](int index){
 	return this->operator [](static_cast<std::size_t>(index));
 }
 
-//JSONEntry& JSONWriter::operator[](const std::string& index);
+const JSONEntry JSONWriter::operator[](const std::string& path) const{
+	std::size_t node = findPath(path);
+	if(node == JSONKeyIndex::npos) return JSONEntry(false);
+
+	const PathNode& pathNode = m_pathNodes[node];
+	if(pathNode.member == JSONKeyIndex::npos) return m_data[pathNode.term];
+	const std::string& term = m_data[pathNode.term].m_data;
+	MemberSpan span;
+	if(!findMember(term, pathNode.member, span)) return JSONEntry(false);
+	return JSONEntry(term.substr(span.keyBegin - 1, span.valueEnd - span.keyBegin + 1));
+}
+
+bool JSONWriter::replaceValue(const std::string& path, const std::string& value){
+	std::size_t node = findPath(path);
+	if(node == JSONKeyIndex::npos || m_pathNodes[node].ordinal != JSONKeyIndex::npos) return false;
+
+	//A term which leaves something open, e.g. "Key":[ has the rest of its value in the terms after it
+	JSONEntry& entry = m_data[m_pathNodes[node].term];
+	//A spliced term becomes a term of its own to be changed, as the text it refers to isn't ours to change
+	if(entry.m_table) entry = JSONEntry(entry.text());
+	if(nestingAfter(entry.m_data, 0) != 0) return false;
+
+	//Only the value of this member is replaced, leaving any others which share its term as they are
+	std::size_t member = m_pathNodes[node].member;
+	MemberSpan span;
+	if(!findMember(entry.m_data, member == JSONKeyIndex::npos ? 0 : member, span)) return false;
+	if(member == JSONKeyIndex::npos) span.valueEnd = entry.m_data.length();
+	entry.m_data.replace(span.valueBegin, span.valueEnd - span.valueBegin, value);
+	entry.m_hashed = false;
+	return true;
+}
 
 void JSONWriter::writeToFile(const std::string& fileName, std::ios_base::openmode openArgs){
 	if(!m_valid) return;
@@ -62,6 +137,118 @@ void JSONWriter::writeToFile(const std::string& fileName, std::ios_base::openmod
 
 }
 
+#ifdef JSON_03_CXX11
+namespace {
+
+	//Shared between the formatting and writing halves of writeToFileAsync
+	struct AsyncWrite {
+		AsyncWrite(const std::string& fileName, bool append, bool syncToDisk)
+			: fileName(fileName), append(append), syncToDisk(syncToDisk), failed(false), freeBuffers(2) {}
+
+		//A copy of the terms to be written, so the writer they came from can be changed or destroyed in the meantime
+		JSONWriter                      content;
+		//The file is opened on the I/O thread along with everything else, so the caller never waits on it
+		std::string                     fileName;
+		bool                            append;
+		std::unique_ptr<JSONOutputFile> file;
+		bool                            syncToDisk;
+		//Only touched by the I/O thread
+		bool                            failed;
+		std::promise<bool>              result;
+
+		std::string                     buffers[2];
+		std::mutex                      mutex;
+		std::condition_variable         bufferFreed;
+		int                             freeBuffers;
+	};
+
+}
+
+std::future<bool> JSONWriter::writeToFileAsync(const std::string& fileName, std::ios_base::openmode openArgs, bool syncToDisk,
+	std::size_t chunkSize){
+	if(!m_valid){
+		std::promise<bool> invalid;
+		invalid.set_value(false);
+		return invalid.get_future();
+	}
+
+	std::shared_ptr<AsyncWrite> state = std::make_shared<AsyncWrite>(fileName, (openArgs & std::ios_base::app) != 0, syncToDisk);
+	std::future<bool> result = state->result.get_future();
+	//Only what formatting needs is copied: the terms, and how any spliced ones are written. The path index stays behind.
+	state->content.m_data = m_data;
+	state->content.m_splices = m_splices;
+
+	JSONIOThread::io().post([state]() {
+		try{
+			state->file.reset(new JSONOutputFile(state->fileName, state->append));
+			state->failed = !state->file->valid();
+		}
+		catch(...){
+			state->failed = true;
+		}
+	});
+
+	JSONIOThread::formatter().post([state, chunkSize]() {
+		const JSONWriter& content = state->content;
+		//Anything thrown while formatting, e.g. running out of memory, is passed on to the caller through the result, once
+		//the writes already queued are done with the file
+		try{
+			std::size_t braceDepth = 0;
+			std::size_t entry = 0;
+			bool opened = false;
+			for(int buffer = 0; entry <= content.m_data.size(); buffer = 1 - buffer){
+				//Wait for the write from two chunks ago to finish with this buffer. Writes happen in order, so it will be this one.
+				{
+					std::unique_lock<std::mutex> lock(state->mutex);
+					state->bufferFreed.wait(lock, [&state]() { return state->freeBuffers > 0; });
+					--state->freeBuffers;
+				}
+
+				std::string& out = state->buffers[buffer];
+				out.clear();
+				if(!opened){
+					out += "{\n";
+					opened = true;
+				}
+				while(entry < content.m_data.size() && out.length() < chunkSize){
+					content.formatEntries(out, entry, entry + 1, braceDepth);
+					++entry;
+				}
+				if(entry == content.m_data.size()){
+					out += "}\n";
+					++entry;
+				}
+
+				JSONIOThread::io().post([state, buffer]() {
+					if(!state->failed) state->failed = !state->file->write(state->buffers[buffer].data(), state->buffers[buffer].length());
+					{
+						std::lock_guard<std::mutex> lock(state->mutex);
+						++state->freeBuffers;
+					}
+					state->bufferFreed.notify_one();
+				});
+			}
+		}
+		catch(...){
+			std::exception_ptr error = std::current_exception();
+			JSONIOThread::io().post([state, error]() {
+				if(state->file) state->file->close();
+				state->result.set_exception(error);
+			});
+			return;
+		}
+
+		JSONIOThread::io().post([state]() {
+			if(state->syncToDisk && !state->failed) state->failed = !state->file->sync();
+			if(state->file && !state->file->close()) state->failed = true;
+			state->result.set_value(!state->failed);
+		});
+	});
+
+	return result;
+}
+#endif
+
 inline bool removeMeaninglessChars(char c){
 	if(c == '\n' || c == '\t' || c == '\r' || c == '\b') return true;
 	return false;
@@ -81,47 +268,409 @@ std::string JSONWriter::getString(bool removeWS){
 
 std::string JSONWriter::processData(){
 
-	std::stringstream out;
-	out << "{\n";
-
+	std::string out = "{\n";
 	std::size_t braceDepth = 0;
-	//We add a dummy closing element as we need to compare against the "next" term in all cases except the end.
-	m_data.push_back(JSONEntry("}"));
-	for(std::size_t i = 0; i < m_data.size() - 1; ++i){
+	formatEntries(out, 0, m_data.size(), braceDepth);
+	out += "}\n";
 
-		if(i > 0){
-			if(m_data[i-1].m_data.find_first_of("{[") != std::string::npos) ++braceDepth;
-			if(m_data[i-1].m_data.find_first_of("}]") != std::string::npos) braceDepth = (braceDepth == 0) ? 0 : braceDepth - 1;
-		}
+	return out;
+}
 
-		for(std::size_t j = 0; j < braceDepth; ++j){
-			out << '\t';
-		}
+void JSONWriter::formatEntries(std::string& out, std::size_t first, std::size_t last, std::size_t& braceDepth) const{
+	for(std::size_t i = first; i < last; ++i){
 
-		out << m_data[i].m_data;
+		out.append(braceDepth, '\t');
+		if(m_data[i].m_table) appendSpliced(out, i, braceDepth);
+		else out += m_data[i].m_data;
 
 		//We add a comma at the end of a row if it is a data row (i.e. not an opening/closing brace) and if it is not at the end of
 		//an array (i.e. the first non-ws character of the next term is not a closing brace or closing square bracket
-		std::size_t thisTermData = m_data[i].m_data.find_last_not_of(" \t\n\r\b");
-		std::size_t nextTermData = m_data[i+1].m_data.find_first_not_of(" \t\n\r\b");
-		if(nextTermData != std::string::npos
-		&& thisTermData != std::string::npos
-		&& m_data[i+1].m_data[nextTermData] != '}'
-		&& m_data[i+1].m_data[nextTermData] != ']'
-		&& m_data[i].m_data[thisTermData] != '{'
-		&& m_data[i].m_data[thisTermData] != '['
-		) out << ',';
+		if(i + 1 < m_data.size()){
+			char thisTermData = lastChar(i);
+			char nextTermData = firstChar(i + 1);
+			if(nextTermData != '\0'
+			&& thisTermData != '\0'
+			&& nextTermData != '}'
+			&& nextTermData != ']'
+			&& thisTermData != '{'
+			&& thisTermData != '['
+			) out += ',';
+		}
+
+		out += '\n';
+
+		braceDepth = nestingAfter(m_data[i].m_data, braceDepth);
+	}
+}
+
+std::size_t JSONWriter::nestingAfter(const std::string& term, std::size_t braceDepth){
+	//Terms can open or close any number of blocks, e.g. "Key":[ or a whole "Aliases":["A","B"], so we count them all,
+	//skipping anything inside a string.
+	for(std::size_t i = 0; i < term.length(); ++i){
+		if(term[i] == '\"') i = findEndOfString(term, i);
+		else if(term[i] == '{' || term[i] == '[') ++braceDepth;
+		else if((term[i] == '}' || term[i] == ']') && braceDepth > 0) --braceDepth;
+	}
+	return braceDepth;
+}
+
+char JSONWriter::firstChar(std::size_t term) const{
+	const JSONEntry& entry = m_data[term];
+	if(entry.m_table){
+		//Spliced terms are written as the entry's text, so an object which isn't a member starts with its first member
+		JSONNodeTable::Node node = entry.m_table->node(entry.m_node);
+		if(node.key != JSONNodeTable::none) return '\"';
+		if(node.type == JSONNodeTable::ObjectNode) return node.childCount > 0 ? '\"' : '\0';
+		if(node.type == JSONNodeTable::ArrayNode) return '[';
+		return entry.m_table->values()[node.begin];
+	}
+	std::size_t found = entry.m_data.find_first_not_of(" \t\n\r\b");
+	return found == std::string::npos ? '\0' : entry.m_data[found];
+}
+
+char JSONWriter::lastChar(std::size_t term) const{
+	const JSONEntry& entry = m_data[term];
+	if(entry.m_table){
+		//Likewise an object which isn't a member ends with its last member
+		const JSONNodeTable& table = *entry.m_table;
+		JSONNodeTable::Node node = table.node(entry.m_node);
+		if(node.key == JSONNodeTable::none && node.type == JSONNodeTable::ObjectNode){
+			if(node.childCount == 0) return '\0';
+			node = table.node(table.child(entry.m_node, node.childCount - 1));
+		}
+		if(node.type == JSONNodeTable::ObjectNode) return '}';
+		if(node.type == JSONNodeTable::ArrayNode) return ']';
+		return table.values()[node.end - 1];
+	}
+	std::size_t found = entry.m_data.find_last_not_of(" \t\n\r\b");
+	return found == std::string::npos ? '\0' : entry.m_data[found];
+}
+
+namespace {
+
+	bool isSpace(char c){
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\b';
+	}
+
+	void newLine(std::string& out, std::size_t depth){
+		out += '\n';
+		out.append(depth, '\t');
+	}
+
+	//Copy [first, last) of some JSON with one value to a line, indented from the given depth. Strings are copied as they
+	//are, in one go.
+	void appendReindented(std::string& out, const std::string& source, std::size_t first, std::size_t last, std::size_t depth){
+		std::size_t level = depth;
+		for(std::size_t i = first; i < last; ++i){
+			char c = source[i];
+			if(c == '\"'){
+				std::size_t closing = std::min(findEndOfString(source, i), last - 1);
+				out.append(source, i, closing - i + 1);
+				i = closing;
+			}
+			else if(isSpace(c)) continue;
+			else if(c == '{' || c == '['){
+				out += c;
+				//Empty objects and arrays are kept on the one line
+				std::size_t next = i + 1;
+				while(next < last && isSpace(source[next])) ++next;
+				if(next < last && (source[next] == '}' || source[next] == ']')){
+					out += source[next];
+					i = next;
+				}
+				else newLine(out, ++level);
+			}
+			else if(c == '}' || c == ']'){
+				if(level > depth) --level;
+				newLine(out, level);
+				out += c;
+			}
+			else{
+				out += c;
+				if(c == ',') newLine(out, level);
+			}
+		}
+	}
+
+}
+
+void JSONWriter::appendSpliced(std::string& out, std::size_t term, std::size_t braceDepth) const{
+	//The table has no whitespace between values to begin with, so only reindenting needs the text to be gone over again
+	const JSONEntry& entry = m_data[term];
+	if(spliceFormat(term) != Reindented){
+		entry.m_table->appendText(out, entry.m_node);
+		return;
+	}
+	std::string text = entry.m_table->text(entry.m_node);
+	appendReindented(out, text, 0, text.length(), braceDepth);
+}
+
+JSONWriter::SpliceFormat JSONWriter::spliceFormat(std::size_t term) const{
+	//Terms are spliced in order, so the list is sorted by term
+	std::size_t low = 0;
+	std::size_t high = m_splices.size();
+	while(low < high){
+		std::size_t mid = low + (high - low) / 2;
+		if(m_splices[mid].term < term) low = mid + 1;
+		else high = mid;
+	}
+	return (low < m_splices.size() && m_splices[low].term == term) ? m_splices[low].format : Verbatim;
+}
+
+JSONWriter JSONWriter::createArraySegment() const{
+	JSONWriter segment;
+	segment.m_isSegment = true;
+	segment.m_arrayDepth = 1;
+	for(std::size_t i = 0; i < m_data.size(); ++i){
+		segment.m_segmentDepth = nestingAfter(m_data[i].m_data, segment.m_segmentDepth);
+	}
+	return segment;
+}
+
+void JSONWriter::finishSegment(){
+	//Anything added after the segment was last finished is formatted along with the text from last time
+	if(!m_isSegment || m_data.empty() || (m_segmentFinished && m_data.size() == 1)) return;
+
+	std::size_t braceDepth = m_segmentDepth;
+	std::string rendered;
+	formatEntries(rendered, 0, m_data.size(), braceDepth);
+
+	//The parent writer indents the first line and ends the last one as it would for any other term
+	rendered.erase(0, m_segmentDepth);
+	rendered.erase(rendered.length() - 1);
+
+	m_data.clear();
+	m_splices.clear();
+	m_data.push_back(JSONEntry(std::string()));
+	m_data[0].m_data.swap(rendered);
+	m_segmentFinished = true;
+}
+
+void JSONWriter::appendSegment(JSONWriter& segment){
+	if(!segment.m_valid) m_valid = false;
+	if(!segment.m_isSegment || segment.m_data.empty()) return;
+
+	//If it has not been done already on its own thread, the segment is formatted here.
+	segment.finishSegment();
+
+	//Swapping the formatted text across means it is never copied
+	m_data.push_back(JSONEntry(std::string()));
+	m_data[m_data.size() - 1].m_data.swap(segment.m_data[0].m_data);
+	segment.m_data.clear();
+
+	//We don't know how many items were in the segment, so no further items of this array can be indexed
+	if(!m_pathScopes.empty()) m_pathScopes[m_pathScopes.size() - 1].itemCount = JSONKeyIndex::npos;
+}
+
+std::size_t JSONWriter::indexMember(std::size_t term){
+	//Segments are spliced into another writer as text, so there is no point indexing them
+	if(m_isSegment) return JSONKeyIndex::npos;
+	std::size_t parent = m_pathScopes.empty() ? JSONKeyIndex::npos : m_pathScopes[m_pathScopes.size() - 1].node;
+	if(!m_pathScopes.empty() && parent == JSONKeyIndex::npos) return JSONKeyIndex::npos;
+
+	std::string name;
+	const JSONEntry& entry = m_data[term];
+	//Spliced terms have their key in the reader's table, so their text is never built just to find it
+	if(entry.m_table){
+		JSONNodeTable::Offset keyID = entry.m_table->node(entry.m_node).key;
+		if(keyID == JSONNodeTable::none) return JSONKeyIndex::npos;
+		name = entry.m_table->keyName(keyID);
+	}
+	else{
+		//A term added from a whole object holds all of its members, and each of them is indexed
+		const std::string& data = entry.m_data;
+		MemberSpan span;
+		if(findMember(data, 1, span)){
+			for(std::size_t member = 0; findMember(data, member, span); ++member){
+				PathNode node = { parent, term, JSONKeyIndex::npos, member };
+				m_pathNodes.push_back(node);
+				m_pathIndex.insert(pathHash(parent, data.substr(span.keyBegin, span.keyEnd - span.keyBegin)), m_pathNodes.size() - 1);
+			}
+			return m_pathNodes.size() - 1;
+		}
+
+		std::pair<std::string::const_iterator, std::string::const_iterator> key = entry.key();
+		if(key.first == data.end() || key.second == data.end()) return JSONKeyIndex::npos;
+		name.assign(key.first, key.second);
+	}
+
+	PathNode node = { parent, term, JSONKeyIndex::npos, JSONKeyIndex::npos };
+	m_pathNodes.push_back(node);
+	m_pathIndex.insert(pathHash(parent, name), m_pathNodes.size() - 1);
+	return m_pathNodes.size() - 1;
+}
+
+std::size_t JSONWriter::indexArrayItem(std::size_t term){
+	if(m_isSegment || m_pathScopes.empty()) return JSONKeyIndex::npos;
+	PathScope& scope = m_pathScopes[m_pathScopes.size() - 1];
+	if(scope.node == JSONKeyIndex::npos || scope.itemCount == JSONKeyIndex::npos) return JSONKeyIndex::npos;
+
+	PathNode node = { scope.node, term, scope.itemCount++, JSONKeyIndex::npos };
+	m_pathNodes.push_back(node);
+	m_pathIndex.insert(itemHash(node.parent, node.ordinal), m_pathNodes.size() - 1);
+	return m_pathNodes.size() - 1;
+}
+
+void JSONWriter::openScope(std::size_t node){
+	if(m_isSegment) return;
+	PathScope scope = { node, 0 };
+	m_pathScopes.push_back(scope);
+}
 
-		out << '\n';
+void JSONWriter::closeScope(){
+	if(!m_pathScopes.empty()) m_pathScopes.pop_back();
+}
 
+std::size_t JSONWriter::findPath(const std::string& path) const{
+	//One lookup per level, each for a node with the right name whose parent is the node we found at the level above
+	std::size_t node = JSONKeyIndex::npos;
+	for(std::size_t start = 0; start <= path.length();){
+		std::size_t end = std::min(path.find('/', start), path.length());
+		node = findChild(node, unescapePathName(path.substr(start, end - start)));
+		if(node == JSONKeyIndex::npos) return JSONKeyIndex::npos;
+		start = end + 1;
 	}
+	return node;
+}
 
-	out << "}\n";
+std::size_t JSONWriter::findChild(std::size_t parent, const std::string& name) const{
+	//Array items are found by their position, and members by their key. A name which is all digits may be either.
+	if(!name.empty() && name.find_first_not_of("0123456789") == std::string::npos){
+		std::size_t ordinal = std::strtoul(name.c_str(), NULL, 10);
+		std::size_t hash = itemHash(parent, ordinal);
+		for(std::size_t slot = m_pathIndex.first(hash); slot != JSONKeyIndex::npos; slot = m_pathIndex.next(hash, slot)){
+			std::size_t candidate = m_pathIndex.value(slot);
+			if(m_pathNodes[candidate].parent == parent && m_pathNodes[candidate].ordinal == ordinal) return candidate;
+		}
+	}
 
-	//And we don't forget to pop our dummy ending off
-	m_data.pop_back();
+	std::string key = escapeString(name);
+	std::size_t hash = pathHash(parent, key);
+	for(std::size_t slot = m_pathIndex.first(hash); slot != JSONKeyIndex::npos; slot = m_pathIndex.next(hash, slot)){
+		std::size_t candidate = m_pathIndex.value(slot);
+		if(m_pathNodes[candidate].parent == parent && nameMatches(candidate, key)) return candidate;
+	}
+	return JSONKeyIndex::npos;
+}
+
+std::string JSONWriter::unescapePathName(const std::string& name){
+	//As in a JSON Pointer, ~1 is a '/' which is part of the name and ~0 is a '~'
+	if(name.find('~') == std::string::npos) return name;
+	std::string out;
+	out.reserve(name.length());
+	for(std::size_t i = 0; i < name.length(); ++i){
+		if(name[i] == '~' && i + 1 < name.length() && (name[i + 1] == '0' || name[i + 1] == '1')){
+			out += (name[++i] == '1') ? '/' : '~';
+		}
+		else out += name[i];
+	}
+	return out;
+}
+
+bool JSONWriter::nameMatches(std::size_t node, const std::string& name) const{
+	const PathNode& pathNode = m_pathNodes[node];
+	if(pathNode.ordinal != JSONKeyIndex::npos) return false;
+	const JSONEntry& entry = m_data[pathNode.term];
+	if(entry.m_table) return entry.m_table->keyName(entry.m_table->node(entry.m_node).key) == name;
+	if(pathNode.member != JSONKeyIndex::npos){
+		MemberSpan span;
+		return findMember(entry.m_data, pathNode.member, span) && entry.m_data.compare(span.keyBegin, span.keyEnd - span.keyBegin, name) == 0;
+	}
+	std::pair<std::string::const_iterator, std::string::const_iterator> key = entry.key();
+	return static_cast<std::size_t>(key.second - key.first) == name.length() && std::equal(name.begin(), name.end(), key.first);
+}
+
+bool JSONWriter::findMember(const std::string& term, std::size_t member, MemberSpan& span){
+	//Members are separated by the commas which aren't nested in anything
+	std::size_t start = 0;
+	std::size_t end = term.length();
+	std::size_t braceDepth = 0;
+	for(std::size_t i = 0; i < term.length(); ++i){
+		if(term[i] == '\"') i = findEndOfString(term, i);
+		else if(term[i] == '{' || term[i] == '[') ++braceDepth;
+		else if((term[i] == '}' || term[i] == ']') && braceDepth > 0) --braceDepth;
+		else if(braceDepth == 0 && term[i] == ','){
+			if(member == 0){
+				end = i;
+				break;
+			}
+			--member;
+			start = i + 1;
+		}
+	}
+	if(member != 0 && end == term.length()) return false;
+
+	start = term.find_first_not_of(" \t\r\n\b", start);
+	if(start >= end || term[start] != '\"') return false;
+	span.keyBegin = start + 1;
+	span.keyEnd = findEndOfString(term, start);
+	std::size_t colon = term.find_first_not_of(" \t\r\n\b", span.keyEnd + 1);
+	if(span.keyEnd >= end || colon >= end || term[colon] != ':') return false;
+	//Any whitespace around the value is left where it is, so the layout of the term doesn't change
+	span.valueBegin = std::min(term.find_first_not_of(" \t\r\n\b", colon + 1), end);
+	span.valueEnd = std::max(term.find_last_not_of(" \t\r\n\b", end - 1) + 1, span.valueBegin);
+	return true;
+}
+
+std::size_t JSONWriter::pathHash(std::size_t parent, const std::string& name){
+	//The same name turns up under many parents, e.g. "name" in every item of an array, so the parent is mixed in too
+	return hashBytes(name.data(), name.length()) * 31 + parent;
+}
+
+std::size_t JSONWriter::itemHash(std::size_t parent, std::size_t ordinal){
+	return ((ordinal ^ fnvOffsetBasis) * fnvPrime) * 31 + parent;
+}
+
+std::string JSONWriter::quotedKey(const std::string& key){
+	std::string out = quoted(key.data(), key.length());
+	out += ':';
+	return out;
+}
+
+std::string JSONWriter::quoted(const char* data, std::size_t length){
+	std::string out;
+	out.reserve(length + 2);
+	appendQuoted(out, data, length);
+	return out;
+}
+
+void JSONWriter::appendQuoted(std::string& out, const char* data, std::size_t length){
+	out += '\"';
+	appendEscaped(out, data, length);
+	out += '\"';
+}
+
+//Warning suppression for MSVC, as with strncpy in JSONEntry. C++03 has no snprintf, but each buffer here is comfortably larger
+//than anything the format can produce.
+void JSONWriter::appendNumber(std::string& out, long value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	out.append(buffer, std::sprintf(buffer, "%ld", value));
+}
+
+void JSONWriter::appendNumber(std::string& out, unsigned long value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	out.append(buffer, std::sprintf(buffer, "%lu", value));
+}
+
+//%g is what a stream uses by default, with the same precision of 6
+void JSONWriter::appendNumber(std::string& out, double value){
+	char buffer[32];
+#pragma warning(suppress : 4996)
+	out.append(buffer, std::sprintf(buffer, "%g", value));
+}
+
+void JSONWriter::appendNumber(std::string& out, long double value){
+	char buffer[64];
+#pragma warning(suppress : 4996)
+	out.append(buffer, std::sprintf(buffer, "%Lg", value));
+}
 
-	return out.str();
+void JSONWriter::addTerm(std::string& term){
+	m_data.push_back(JSONEntry(std::string()));
+	m_data[m_data.size() - 1].m_data.swap(term);
+	indexMember(m_data.size() - 1);
 }
 
 bool JSONWriter::valid(){
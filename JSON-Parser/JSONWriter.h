@@ -7,22 +7,66 @@
 #include <string>
 #include <ios>
 #include <sstream>
+#include <iterator>
+
+#include "JSONConfig.h"
+#ifdef JSON_03_CXX11
+#include <future>
+#endif
 
 #include "JSONEntry.h"
+#include "JSONString.h"
+#include "JSONKeyIndex.h"
 #include "Tags.h"
 
 class JSONWriter{
 
 public:
-	 JSONWriter() : m_arrayDepth(0), m_valid(true) {};
+	 JSONWriter() : m_valid(true), m_arrayDepth(0), m_isSegment(false), m_segmentFinished(false), m_segmentDepth(0) {};
 
-     //Templated to allow non-string types to make it into the JSON
+     //Templated to allow non-string types to make it into the JSON.
+	 //Whole containers can be added in one go: vectors, deques, lists and arrays become JSON arrays, and maps with string
+	 //keys become objects, nested as deeply as you like, e.g. a std::map<std::string, std::vector<double> >.
 	 template<typename T>
 	 void add(const std::string& key, const T& value){
-		m_data.push_back(JSONEntry("\"" + key + "\":" + add_helper<T>::get(value, instance_of<T>())));
+		std::string term = quotedKey(key);
+		//Containers are written out in one go, so we make room for all of it at once
+		term.reserve(term.length() + add_helper<T>::sizeHint(value, instance_of<T>()));
+		add_helper<T>::append(term, value, instance_of<T>());
+		addTerm(term);
+	 }
+
+	 //As above, for the values in [first, last) of any forward iterator, which are written as a JSON array
+	 template<typename Iterator>
+	 void addRange(const std::string& key, Iterator first, Iterator last){
+		std::string term = quotedKey(key);
+		term.reserve(term.length() + rangeSizeHint(first, last));
+		appendRange(term, first, last);
+		addTerm(term);
 	 }
 
 	 void add(const JSONEntry& newElement);
+
+	 //How a spliced entry is written: exactly as its text is, with all of the whitespace between its values removed, or laid
+	 //out afresh with one value to a line, indented to fit where it is in the output. An indexed reader doesn't keep the
+	 //whitespace of its source, so for its entries the first two are the same.
+	 enum SpliceFormat {
+		Verbatim,
+		Minified,
+		Reindented
+	 };
+
+	 /*
+	 *  Adds an entry as add() does, but for entries from an indexed reader nothing is copied: the writer keeps a reference to
+	 *  the reader's data, and the entry's text is copied from there straight into the output as it is written, so forwarding
+	 *  a large part of one document into another costs a single copy. The reader's data is kept alive for as long as the
+	 *  writer needs it. Other entries hold their own copy of their text already, and are added as add() would add them.
+	 */
+	 void splice(const JSONEntry& newElement, SpliceFormat format = Verbatim);
+
+	 //No-escape fast path, for string values which are already known to be clean (or already escaped) and so can be written
+	 //between quotes as-is without being scanned.
+	 void addPreEscaped(const std::string& key, const std::string& value);
 	 //Start a full array, i.e. insert a [ or ] into the current file
 	 void startArray(const std::string& key);
 	 void endArray();
@@ -31,14 +75,26 @@ public:
 	 //void addSimpleArrayItem(const std::string& input);
 	 template<typename T>
 	 void addSimpleArrayItem(const T& newItem){
-		if(m_arrayDepth == 0 || m_data.empty()) return;
+		if(m_arrayDepth == 0) return;
+		//A segment has no "Key":[ of its own to add to, so its first item starts a new term. So does an item after a spliced
+		//term, which refers to its text elsewhere rather than holding it.
+		if(m_data.empty() || m_data[m_data.size() - 1].m_table){
+			if(m_isSegment || !m_data.empty()){
+				std::string term;
+				add_helper<T>::append(term, newItem, instance_of<T>());
+				m_data.push_back(JSONEntry(term));
+			}
+			return;
+		}
 
 		std::string& mostRecentTerm = m_data[m_data.size() - 1].m_data;
 		std::size_t lastTokenIndex = mostRecentTerm.find_last_not_of(" \t\n\r\b");
 		if(lastTokenIndex == std::string::npos) return;
 		if(mostRecentTerm[lastTokenIndex] != '[') mostRecentTerm += ",";
 
-		mostRecentTerm+= add_helper<T>::get(newItem, instance_of<T>());
+		add_helper<T>::append(mostRecentTerm, newItem, instance_of<T>());
+		//The term has changed under any hash it had
+		m_data[m_data.size() - 1].m_hashed = false;
 
 	 }
 
@@ -48,13 +104,56 @@ public:
 	 void startArrayItem();
 	 void endArrayItem();
 
+	 /*
+	 *  For building very large arrays in parallel. Once an array has been started, any number of segments can be created from
+	 *  the writer and handed to different threads, which fill them with startArrayItem()/add()/endArrayItem() or
+	 *  addSimpleArrayItem() as they would the writer itself, then call finishSegment() to format them on that thread.
+	 *  Back on the original thread, the segments are added in order with appendSegment(), which moves the formatted text
+	 *  across without copying it, before the array is ended as normal. Each writer must only be used by one thread at a time.
+	 */
+	 JSONWriter createArraySegment() const;
+	 void finishSegment();
+	 void appendSegment(JSONWriter& segment);
+
 	 JSONEntry& operator[](std::size_t index);
 	 JSONEntry& operator[](int index);
-	 JSONEntry& operator[](const std::string& index);
+
+	 /*
+	 *  Lookup by path, e.g. writer["users/3/name"], with the keys of objects and the indices of array items separated by '/'.
+	 *  Every key and array item is indexed as it is added, so this is a hash lookup per level rather than a search. The entry
+	 *  returned is a copy of the term which starts that path, or an invalid entry if there is nothing there; use replace()
+	 *  to change it. Where a term holds several members, e.g. one added from a whole element of an array, each member is
+	 *  indexed and returned on its own. Simple array items, and any items added by appendSegment(), are not indexed
+	 *  individually.
+	 *  As in a JSON Pointer, a '/' which is part of a key is written as ~1, and a '~' as ~0, e.g. writer["sizes/10~1100"].
+	 */
+	 const JSONEntry operator[](const std::string& path) const;
+
+	 //Change the value at a path in place, keeping its key and its position. Nothing else in the writer is touched.
+	 //This fails for paths which aren't there, and for arrays whose items were added separately, as they span many terms.
+	 template<typename T>
+	 bool replace(const std::string& path, const T& value){
+		std::string newValue;
+		newValue.reserve(add_helper<T>::sizeHint(value, instance_of<T>()));
+		add_helper<T>::append(newValue, value, instance_of<T>());
+		return replaceValue(path, newValue);
+	 }
 
 	 void writeToFile(const std::string& filePathAndName, std::ios_base::openmode openArgs = std::ios_base::out);
 	 std::string getString(bool removeWS = false);
 
+#ifdef JSON_03_CXX11
+	 /*
+	 *  As writeToFile, but without blocking the caller. The data is formatted a chunk at a time on a background thread and
+	 *  handed to the I/O thread to write, using two buffers so that one chunk is formatted while the last is written.
+	 *  The result is whether the whole file was written successfully, and with syncToDisk it is only set once the data has
+	 *  reached the disk rather than the OS's cache. The terms are copied before this returns, so the writer may be changed or
+	 *  destroyed straight away.
+	 */
+	 std::future<bool> writeToFileAsync(const std::string& filePathAndName, std::ios_base::openmode openArgs = std::ios_base::out,
+		bool syncToDisk = false, std::size_t chunkSize = 65536);
+#endif
+
 	 bool valid();
      bool operator!();
 
@@ -63,52 +162,236 @@ private:
 
 	std::string processData();
 
+	//Format entries [first, last) one per line, indented according to braceDepth which is kept up to date as we go
+	void formatEntries(std::string& out, std::size_t first, std::size_t last, std::size_t& braceDepth) const;
+	static std::size_t nestingAfter(const std::string& term, std::size_t braceDepth);
+	//The first and last characters of a term other than whitespace, or '\0' if it has none
+	char firstChar(std::size_t term) const;
+	char lastChar(std::size_t term) const;
+
+	//Spliced terms are those which still refer to an indexed reader's data. Their text is written straight from there.
+	void appendSpliced(std::string& out, std::size_t term, std::size_t braceDepth) const;
+	SpliceFormat spliceFormat(std::size_t term) const;
+
+	//Produces "key": with any escaping the key needs
+	static std::string quotedKey(const std::string& key);
+	static std::string quoted(const char* data, std::size_t length);
+	static void appendQuoted(std::string& out, const char* data, std::size_t length);
+
+	//Numbers are written as a stream would write them by default, but without the cost of constructing a stream each time
+	static void appendNumber(std::string& out, long value);
+	static void appendNumber(std::string& out, unsigned long value);
+	static void appendNumber(std::string& out, double value);
+	static void appendNumber(std::string& out, long double value);
+
+	//Moves the text of a finished term into a new entry
+	void addTerm(std::string& term);
+
+	//Add the term to the index of paths, as a key within the current object or the next item of the current array.
+	//The node for the new path is returned, or npos if it could not be indexed.
+	std::size_t indexMember(std::size_t term);
+	std::size_t indexArrayItem(std::size_t term);
+	void openScope(std::size_t node);
+	void closeScope();
+	std::size_t findPath(const std::string& path) const;
+	std::size_t findChild(std::size_t parent, const std::string& name) const;
+	static std::string unescapePathName(const std::string& name);
+	bool nameMatches(std::size_t node, const std::string& name) const;
+
+	//Where the key (without its quote marks) and the value of one member of a term are, for terms which hold several
+	struct MemberSpan {
+		std::size_t keyBegin;
+		std::size_t keyEnd;
+		std::size_t valueBegin;
+		std::size_t valueEnd;
+	};
+	static bool findMember(const std::string& term, std::size_t member, MemberSpan& span);
+	static std::size_t pathHash(std::size_t parent, const std::string& name);
+	static std::size_t itemHash(std::size_t parent, std::size_t ordinal);
+	bool replaceValue(const std::string& path, const std::string& value);
+
 	bool                    m_valid;
 	std::size_t             m_arrayDepth;
 	std::vector<JSONEntry> 	m_data;
 
+	//The terms which were spliced, in the order they were added, and how each is to be written
+	struct Splice {
+		std::size_t              term;
+		SpliceFormat             format;
+		JSONNodeTable::Reference table;
+	};
+	std::vector<Splice>     m_splices;
+
+	//For segments of an array, whether they have been formatted yet and the depth they will be added back at
+	bool                    m_isSegment;
+	bool                    m_segmentFinished;
+	std::size_t             m_segmentDepth;
+
+	//Each key or array item added is a node in a tree of paths. Nodes are found by hashing the name of the node together
+	//with its parent, so the keys themselves are never copied - they are checked against the terms they came from.
+	struct PathNode {
+		std::size_t parent;
+		std::size_t term;
+		//The position of an array item within its array, or npos for a key
+		std::size_t ordinal;
+		//For a term which holds several members of an object, which of them this is; npos for a term of one member
+		std::size_t member;
+	};
+	//The objects and arrays currently open, and how many items have been added to each (npos when that is unknown)
+	struct PathScope {
+		std::size_t node;
+		std::size_t itemCount;
+	};
+	std::vector<PathNode>   m_pathNodes;
+	std::vector<PathScope>  m_pathScopes;
+	JSONKeyIndex            m_pathIndex;
+
+	/*
+	*  A series of overloads to write data of each type into the JSON, in the same way as JSONEntry::as_helper reads it back.
+	*  Everything is appended onto the end of a string, so a container of many values is written into a single string
+	*  without any temporaries along the way. sizeHint() gives a rough idea of how much space a value will need, so room
+	*  for a whole container can be made at once.
+	*/
 	template<typename T>
 	struct add_helper{
 		//String types;
-		static inline std::string get(const T& in, tag_std_string){
-			return "\"" + std::string(in.begin(),in.end()) + "\"";
+		static inline void append(std::string& out, const T& in, tag_std_string){
+			std::string narrow(in.begin(),in.end());
+			appendQuoted(out, narrow.data(), narrow.length());
+		}
+		static inline std::size_t sizeHint(const T& in, tag_std_string){
+			return in.length() + 2;
 		}
 		#ifdef __TCPLUSPLUS__
-		static inline std::string get(const T& in, tag_delphi_string){
-			return "\"" + std::string(in.begin(),in.end()) + "\"";
+		static inline void append(std::string& out, const T& in, tag_delphi_string){
+			std::string narrow(in.begin(),in.end());
+			appendQuoted(out, narrow.data(), narrow.length());
+		}
+		static inline std::size_t sizeHint(const T& in, tag_delphi_string){
+			return in.Length() + 2;
 		}
 		#endif
 		template<std::size_t N>
-		static inline std::string get(const T& in, instance_of<char[N]>){
-            return std::string("\"") + in + "\"";
+		static inline void append(std::string& out, const T& in, instance_of<char[N]>){
+			appendQuoted(out, in, std::char_traits<char>::length(in));
+		}
+		template<std::size_t N>
+		static inline std::size_t sizeHint(const T&, instance_of<char[N]>){
+			return N + 1;
 		}
 
 		//Numerical types
-		static inline std::string get(const T& in, tag_any_int){
-			std::stringstream sstr;
-			sstr << in;
-			std::string out;
-			sstr >> out;
-			return  out;
+		static inline void append(std::string& out, const T& in, tag_signed_int){
+			appendNumber(out, static_cast<long>(in));
+		}
+		static inline void append(std::string& out, const T& in, tag_unsigned_int){
+			appendNumber(out, static_cast<unsigned long>(in));
+		}
+		static inline void append(std::string& out, const T& in, tag_floating_point){
+			appendNumber(out, static_cast<double>(in));
 		}
-		static inline std::string get(const T& in, tag_floating_point){
-			std::stringstream sstr;
-			sstr << in;
-			std::string out;
-			sstr >> out;
-			return out;
+		static inline void append(std::string& out, const T& in, instance_of<long double>){
+			appendNumber(out, in);
 		}
 
 		//Misc types
-		static inline std::string get(const T& in, instance_of<char>){
-			return std::string("\"") + in + "\"";
+		static inline void append(std::string& out, const T& in, instance_of<char>){
+			appendQuoted(out, &in, 1);
 		}
-		static inline std::string get(const T& in, instance_of<bool>){
-			if(in) return "true";
-			else return "false";
+		static inline void append(std::string& out, const T& in, instance_of<bool>){
+			if(in) out += "true";
+			else out += "false";
+		}
+
+		//Containers
+		static inline void append(std::string& out, const T& in, tag_sequence){
+			appendRange(out, beginOf(in), endOf(in));
+		}
+		static inline std::size_t sizeHint(const T& in, tag_sequence){
+			return rangeSizeHint(beginOf(in), endOf(in));
+		}
+		static inline void append(std::string& out, const T& in, tag_string_map){
+			appendMap(out, in);
+		}
+		static inline std::size_t sizeHint(const T& in, tag_string_map){
+			return mapSizeHint(in);
+		}
+
+		//Numbers are short, so a rough guess does for all of them
+		static inline std::size_t sizeHint(const T&, tag_any_int){
+			return 8;
+		}
+		static inline std::size_t sizeHint(const T&, tag_floating_point){
+			return 12;
+		}
+		static inline std::size_t sizeHint(const T&, instance_of<char>){
+			return 3;
+		}
+		static inline std::size_t sizeHint(const T&, instance_of<bool>){
+			return 5;
 		}
 
 	};
 
+	template<typename Iterator>
+	static void appendRange(std::string& out, Iterator first, Iterator last){
+		typedef typename std::iterator_traits<Iterator>::value_type value_type;
+		out += '[';
+		for(Iterator it = first; it != last; ++it){
+			if(it != first) out += ',';
+			add_helper<value_type>::append(out, *it, instance_of<value_type>());
+		}
+		out += ']';
+	}
+
+	template<typename Iterator>
+	static std::size_t rangeSizeHint(Iterator first, Iterator last){
+		typedef typename std::iterator_traits<Iterator>::value_type value_type;
+		std::size_t hint = 2;
+		for(; first != last; ++first) hint += add_helper<value_type>::sizeHint(*first, instance_of<value_type>()) + 1;
+		return hint;
+	}
+
+	template<typename Map>
+	static void appendMap(std::string& out, const Map& in){
+		typedef typename Map::mapped_type mapped_type;
+		out += '{';
+		for(typename Map::const_iterator it = in.begin(); it != in.end(); ++it){
+			if(it != in.begin()) out += ',';
+			appendQuoted(out, it->first.data(), it->first.length());
+			out += ':';
+			add_helper<mapped_type>::append(out, it->second, instance_of<mapped_type>());
+		}
+		out += '}';
+	}
+
+	template<typename Map>
+	static std::size_t mapSizeHint(const Map& in){
+		typedef typename Map::mapped_type mapped_type;
+		std::size_t hint = 2;
+		for(typename Map::const_iterator it = in.begin(); it != in.end(); ++it){
+			hint += it->first.length() + 4 + add_helper<mapped_type>::sizeHint(it->second, instance_of<mapped_type>());
+		}
+		return hint;
+	}
+
+	//Built-in arrays have no begin() and end() of their own
+	template<typename C>
+	static typename C::const_iterator beginOf(const C& in){
+		return in.begin();
+	}
+	template<typename C>
+	static typename C::const_iterator endOf(const C& in){
+		return in.end();
+	}
+	template<typename U, std::size_t N>
+	static const U* beginOf(const U (&in)[N]){
+		return in;
+	}
+	template<typename U, std::size_t N>
+	static const U* endOf(const U (&in)[N]){
+		return in + N;
+	}
+
 };
 #endif
\ No newline at end of file
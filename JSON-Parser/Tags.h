@@ -2,6 +2,17 @@
 #define TMP_03_TAGS
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <cstddef>
+
+#include "JSONConfig.h"
+#ifdef JSON_03_CXX11
+#include <array>
+#include <unordered_map>
+#endif
 
 #ifdef __TCPLUSPLUS__
 #include <vcl.h>
@@ -83,6 +94,34 @@ struct tag_char {
 	tag_char(instance_of<wchar_t>) {}
 };
 
+//Containers which hold a sequence of values, which become JSON arrays
+struct tag_sequence {
+	tag_sequence() {}
+	template<typename T, typename A>
+	tag_sequence(instance_of<std::vector<T, A> >) {}
+	template<typename T, typename A>
+	tag_sequence(instance_of<std::deque<T, A> >) {}
+	template<typename T, typename A>
+	tag_sequence(instance_of<std::list<T, A> >) {}
+	template<typename T, std::size_t N>
+	tag_sequence(instance_of<T[N]>) {}
+#ifdef JSON_03_CXX11
+	template<typename T, std::size_t N>
+	tag_sequence(instance_of<std::array<T, N> >) {}
+#endif
+};
+
+//Containers of values looked up by a string, which become JSON objects
+struct tag_string_map {
+	tag_string_map() {}
+	template<typename T, typename C, typename A>
+	tag_string_map(instance_of<std::map<std::string, T, C, A> >) {}
+#ifdef JSON_03_CXX11
+	template<typename T, typename H, typename E, typename A>
+	tag_string_map(instance_of<std::unordered_map<std::string, T, H, E, A> >) {}
+#endif
+};
+
 
 
 
@@ -1,9 +1,22 @@
 #include <iostream>
 #include <random>
+#include <thread>
+#include <future>
+#include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 
 #include "JSONEntry.h"
 #include "JSONWriter.h"
 #include "JSONReader.h"
+#include "JSONStreamReader.h"
+#include "JSONValidator.h"
+#include "JSONQuery.h"
+#include "JSONStatic.h"
 
 JSONWriter getNamesJSON() {
 	JSONWriter out;
@@ -66,7 +79,7 @@ bool copyUsers() {
 	for (int i = 0; i < 5; ++i) {
 		out.startArrayItem();
 		//Two different ways to make the copy:
-		out.add("userId", Users["users"][i]["userId"].as<std::string>());
+		out.add("userId", Users["users"][i]["userId"].as<int>());
 		//Can also accept an entry in another list directly.
 		out.add(Users["users"][i]["firstName"]);
 		//Can also validate
@@ -139,6 +152,668 @@ bool testAccessSpecifier() {
 	
 }
 
+bool escapeRoundTrip() {
+	//Awkward characters, long enough that the clean runs between them are scanned in blocks
+	std::string awkward = "She said \"Hello, World!\" {and} left\\\n\ta tab, a \x01 control character and a longer clean run to finish";
+	std::string clean = "Nothing in this one needs escaping at all, however long it may be";
+
+	JSONWriter out;
+	out.add("Awkward \"Key\"", awkward);
+	out.add("Clean", clean);
+	out.addPreEscaped("PreEscaped", "Line one\\nLine two");
+	out.add("Number", 42);
+
+	JSONReader in = JSONReader::createFromString(out.getString());
+	if (!in) return false;
+
+	bool roundTrip = in["Awkward \"Key\""].as<std::string>() == awkward
+		&& in["Clean"].as<std::string>() == clean
+		&& in["PreEscaped"].as<std::string>() == "Line one\nLine two"
+		&& in["Number"].as<int>() == 42;
+
+	//Surrogate pairs and other \u escapes are decoded to UTF-8
+	bool unicode = unescapeString("caf\\u00e9 \\ud83d\\ude00") == "caf\xc3\xa9 \xf0\x9f\x98\x80"
+		&& validUTF8(std::string("caf\xc3\xa9 \xf0\x9f\x98\x80"))
+		&& !validUTF8(std::string("overlong \xc0\xaf"))
+		&& !validUTF8(std::string("surrogate \xed\xa0\x80"));
+
+	return roundTrip && unicode;
+}
+
+bool rootArrayCheck() {
+	JSONReader Users("Users.json");
+	JSONReader whole("UsersArray.json");
+	if (!Users || !whole) return false;
+
+	//A deliberately small chunk size, so elements are split across many reads
+	JSONStreamReader streamed("UsersArray.json", 16);
+	int count = 0;
+	for (JSONEntry user = streamed.next(); user.valid(); user = streamed.next()) {
+		for (int j = 0; j < 5; ++j) {
+			if (user[j] != Users["users"][count][j] || whole[count][j] != Users["users"][count][j]) return false;
+		}
+		++count;
+	}
+
+	return streamed.valid() && streamed.atEnd() && count == 5 && whole[4]["lastName"].as<std::string>() == "mac" && !whole[5];
+}
+
+bool concurrentLookups() {
+	//One shared reader, queried from many threads at once. The key index is built lazily by whichever threads get there first.
+	const JSONReader shared("Users.json");
+	if (!shared) return false;
+
+	std::string lastNames[5] = { "Lee", "jacson", "roast", "neo", "mac" };
+	const int threadCount = 64;
+	std::vector<char> results(threadCount, 0);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < threadCount; ++t) {
+		threads.push_back(std::thread([&shared, &results, &lastNames, t]() {
+			//Half the threads work from their own copy, which shares the same document
+			JSONReader copy = shared;
+			const JSONReader& reader = (t % 2 == 0) ? shared : copy;
+			bool allMatch = true;
+			for (int i = 0; i < 200; ++i) {
+				int user = (i + t) % 5;
+				allMatch = allMatch && reader["users"][user]["lastName"].as<std::string>() == lastNames[user]
+					&& reader["users"][user]["userId"].as<int>() == user + 1
+					&& !reader["no such key"];
+			}
+			results[t] = allMatch;
+		}));
+	}
+	for (std::size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+	return std::count(results.begin(), results.end(), 1) == threadCount;
+}
+
+void fillUsers(JSONWriter& out, int first, int last) {
+	for (int i = first; i < last; ++i) {
+		out.startArrayItem();
+		out.add("userId", i);
+		out.add("name", "User " + std::to_string(i));
+		out.startArray("scores");
+		out.addSimpleArrayItem(i % 7);
+		out.addSimpleArrayItem(i % 11);
+		out.endArray();
+		out.endArrayItem();
+	}
+}
+
+bool parallelSegments() {
+	const int itemCount = 10000;
+	const int threadCount = 8;
+
+	JSONWriter serial;
+	serial.add("Title", "Users");
+	serial.startArray("users");
+	fillUsers(serial, 0, itemCount);
+	serial.endArray();
+
+	JSONWriter parallel;
+	parallel.add("Title", "Users");
+	parallel.startArray("users");
+	std::vector<JSONWriter> userSegments(threadCount, parallel.createArraySegment());
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; ++t) {
+		threads.push_back(std::thread([&userSegments, t, itemCount, threadCount]() {
+			fillUsers(userSegments[t], t * itemCount / threadCount, (t + 1) * itemCount / threadCount);
+			userSegments[t].finishSegment();
+		}));
+	}
+	for (std::size_t t = 0; t < threads.size(); ++t) threads[t].join();
+	for (int t = 0; t < threadCount; ++t) parallel.appendSegment(userSegments[t]);
+	parallel.endArray();
+	bool matchesSerial = parallel.getString() == serial.getString();
+
+	//Simple items work the same way (though each segment gets a line of its own), and segments don't have to be finished
+	//on their own thread
+	parallel.startArray("ids");
+	std::vector<JSONWriter> idSegments(threadCount, parallel.createArraySegment());
+	for (int t = 0; t < threadCount; ++t) {
+		for (int i = t * itemCount / threadCount; i < (t + 1) * itemCount / threadCount; ++i) idSegments[t].addSimpleArrayItem(i);
+		parallel.appendSegment(idSegments[t]);
+	}
+	parallel.endArray();
+
+	JSONReader readBack = JSONReader::createFromString(parallel.getString());
+	bool idsMatch = true;
+	for (int i = 0; i < itemCount; i += 1249) idsMatch = idsMatch && readBack["ids"][i].as<int>() == i;
+
+	return matchesSerial && idsMatch && readBack["users"][itemCount - 1]["userId"].as<int>() == itemCount - 1;
+}
+
+bool asyncFileIO() {
+	JSONWriter out;
+	out.add("Title", "Users");
+	out.startArray("users");
+	fillUsers(out, 0, 1000);
+	out.endArray();
+
+	//A small chunk size, so the formatting and writing take turns with both buffers many times over
+	std::future<bool> written = out.writeToFileAsync("AsyncUsers.json", std::ios_base::out, true, 256);
+	if (!written.get()) return false;
+
+	std::future<JSONReader> loaded = JSONReader::loadAsync("AsyncUsers.json");
+	JSONReader in = loaded.get();
+	JSONReader missing = JSONReader::loadAsync("NoSuchFile.json").get();
+	bool unwritable = !out.writeToFileAsync("NoSuchDirectory/AsyncUsers.json").get();
+
+	//The write takes its own copy of the data, so the writer can be changed and thrown away before the write is done
+	std::future<bool> detached;
+	{
+		JSONWriter temporary = out;
+		detached = temporary.writeToFileAsync("AsyncUsersCopy.json", std::ios_base::out, false, 256);
+		temporary.add("Late", "Not written");
+	}
+	bool copied = detached.get();
+	JSONReader copy = JSONReader::loadAsync("AsyncUsersCopy.json", JSONReader::Indexed).get();
+	std::remove("AsyncUsersCopy.json");
+
+	return in.valid() && !missing && unwritable && in["users"][999]["name"].as<std::string>() == "User 999"
+		&& JSONReader::createFromString(out.getString())["users"] == in["users"]
+		&& copied && copy["users"][999]["name"].as<std::string>() == "User 999" && !copy["Late"];
+}
+
+bool snapshotDiff() {
+	JSONWriter before;
+	before.add("Title", "Users");
+	before.startArray("users");
+	fillUsers(before, 0, 100);
+	before.endArray();
+
+	//The same users, one renamed, plus a new key
+	JSONWriter after;
+	after.add("Title", "Users");
+	after.startArray("users");
+	fillUsers(after, 0, 42);
+	after.startArrayItem();
+	after.add("userId", 42);
+	after.add("name", "Renamed");
+	after.startArray("scores");
+	after.addSimpleArrayItem(42 % 7);
+	after.addSimpleArrayItem(42 % 11);
+	after.endArray();
+	after.endArrayItem();
+	fillUsers(after, 43, 100);
+	after.endArray();
+	after.add("Updated", true);
+
+	JSONReader first = JSONReader::createFromString(before.getString());
+	JSONReader minified = JSONReader::createFromString(before.getString(true));
+	JSONReader second = JSONReader::createFromString(after.getString());
+	if (!first || !minified || !second) return false;
+
+	//Whitespace makes no difference to equality, or to the hash
+	bool sameData = first["users"] == minified["users"] && first["users"].hash() == minified["users"].hash()
+		&& diff(first, minified).empty() && first["users"][3] == minified["users"][3];
+
+	std::vector<std::string> changes = diff(first, second);
+	std::vector<std::string> entryChanges = diff(first["users"], second["users"]);
+
+	//An indexed reader finds the same changes from the hashes in its table
+	JSONReader firstIndexed = JSONReader::createFromString(before.getString(), JSONReader::Indexed);
+	JSONReader secondIndexed = JSONReader::createFromString(after.getString(), JSONReader::Indexed);
+	std::vector<std::string> indexedChanges = diff(firstIndexed["users"], secondIndexed["users"]);
+	bool indexed = firstIndexed["users"] == first["users"] && firstIndexed["users"].hash() == first["users"].hash()
+		&& indexedChanges == entryChanges && diff(firstIndexed["users"], first["users"]).empty();
+
+	//A string is never equal to a value of another type with the same text
+	bool types = true;
+	for (int mode = 0; mode < 2; ++mode) {
+		JSONReader values = JSONReader::createFromString("[\"[1,2]\", [1, 2], \"4\", 4, 4]",
+			mode == 0 ? 0u : static_cast<unsigned>(JSONReader::Indexed));
+		types = types && values[0] != values[1] && values[2] != values[3] && values[3] == values[4]
+			&& diff(values[2], values[3]).size() == 1;
+	}
+
+	return sameData && indexed && types && first["users"] != second["users"]
+		&& changes.size() == 2 && changes[0] == "Updated" && changes[1] == "users/42/name"
+		&& entryChanges.size() == 1 && entryChanges[0] == "users/42/name";
+}
+
+bool writerPaths() {
+	JSONWriter out;
+	out.add("Title", "Users");
+	out.add("Awkward \"Key\"", 1);
+	out.add("Either/Or", "slash");
+	out.add("~", "tilde");
+	out.startArray("Aliases");
+	out.addSimpleArrayItem("John Smith");
+	out.addSimpleArrayItem("Theta Sigma");
+	out.endArray();
+	out.startArray("users");
+	fillUsers(out, 0, 1000);
+	out.endArray();
+
+	bool lookups = out["Title"].as<std::string>() == "Users"
+		&& out["Awkward \"Key\""].as<int>() == 1
+		&& out["users/999/userId"].as<int>() == 999
+		&& out["users/500/name"].as<std::string>() == "User 500"
+		&& !out["users/1000/name"] && !out["users/5/nothing"] && !out["nothing"]
+		&& out["Either~1Or"].as<std::string>() == "slash" && out["~0"].as<std::string>() == "tilde" && !out["Either/Or"];
+
+	//A term added from a whole element of an array holds several members, and replacing one must leave the rest alone
+	bool members = true;
+	for (int mode = 0; mode < 2; ++mode) {
+		JSONReader users("Users.json", mode == 0 ? 0u : static_cast<unsigned>(JSONReader::Indexed));
+		JSONWriter copy;
+		copy.add(users["users"][1]);
+		members = members && copy["firstName"].as<std::string>() == users["users"][1]["firstName"].as<std::string>()
+			&& copy.replace("userId", 5) && copy.replace("firstName", "Someone");
+		JSONReader copied = JSONReader::createFromString(copy.getString());
+		members = members && copied["userId"].as<int>() == 5 && copied["firstName"].as<std::string>() == "Someone"
+			&& copied["lastName"].as<std::string>() == users["users"][1]["lastName"].as<std::string>();
+	}
+
+	//Patch some fields in place, including some which change the length of the term
+	bool patched = out.replace("Title", "Patched users")
+		&& out.replace("users/500/name", "Someone \"Else\"")
+		&& out.replace("users/7/userId", 70000)
+		&& out.replace("Aliases", 3)
+		&& !out.replace("users", 1)
+		&& !out.replace("users/3", 1)
+		&& !out.replace("nothing", 1);
+
+	JSONReader in = JSONReader::createFromString(out.getString());
+	return lookups && members && patched && in["Title"].as<std::string>() == "Patched users"
+		&& in["users"][500]["name"].as<std::string>() == "Someone \"Else\""
+		&& in["users"][7]["userId"].as<int>() == 70000 && in["Aliases"].as<int>() == 3
+		&& in["users"][501]["name"].as<std::string>() == "User 501" && in["users"][999]["userId"].as<int>() == 999;
+}
+
+bool containerSerialisation() {
+	std::vector<double> readings;
+	for (int i = 0; i < 10000; ++i) readings.push_back(i * 0.25);
+	std::map<std::string, std::vector<int> > groups;
+	groups["odd"].push_back(1);
+	groups["odd"].push_back(3);
+	groups["even \"numbers\""].push_back(2);
+	std::deque<std::map<std::string, std::string> > people(2);
+	people[1]["name"] = "The Doctor";
+	int codes[3] = { 7, 8, 9 };
+
+	JSONWriter out;
+	out.add("readings", readings);
+	out.add("groups", groups);
+	out.add("people", people);
+	out.add("codes", codes);
+	out.addRange("lastCodes", codes + 1, codes + 3);
+
+	//Containers are written with the same formatting as their values would be one at a time
+	JSONWriter oneByOne;
+	oneByOne.startArray("readings");
+	for (std::size_t i = 0; i < readings.size(); ++i) oneByOne.addSimpleArrayItem(readings[i]);
+	oneByOne.endArray();
+
+	JSONReader in = JSONReader::createFromString(out.getString());
+	JSONReader expected = JSONReader::createFromString(oneByOne.getString());
+	return in["readings"] == expected["readings"] && in["readings"][9999].as<double>() == 9999 * 0.25
+		&& in["groups"]["odd"][1].as<int>() == 3 && in["groups"]["even \"numbers\""].as<int>() == 2
+		&& in["people"][1]["name"].as<std::string>() == "The Doctor"
+		&& in["codes"][2].as<int>() == 9 && in["lastCodes"][0].as<int>() == 8;
+}
+
+bool indexedReader() {
+	JSONReader Users("Users.json");
+	JSONReader indexedUsers("Users.json", JSONReader::Indexed);
+	JSONReader indexedArray("UsersArray.json", JSONReader::Indexed);
+	JSONReader qz("QuizQuestion.json");
+	JSONReader indexedQz("QuizQuestion.json", JSONReader::Indexed);
+	if (!Users || !indexedUsers || !indexedArray || !qz || !indexedQz) return false;
+
+	//Indexed readers should give the same answers, whichever way they're asked
+	for (int i = 0; i < 5; ++i) {
+		for (int j = 0; j < 5; ++j) {
+			if (indexedUsers["users"][i][j] != Users["users"][i][j] || indexedArray[i][j] != Users["users"][i][j]) return false;
+		}
+		if (indexedUsers["users"][i]["lastName"].as<std::string>() != Users["users"][i]["lastName"].as<std::string>()) return false;
+	}
+	std::string question = "question";
+	bool quiz = indexedQz["quiz"]["maths"]["q1"]["options"][2].as<int>() == 12
+		&& indexedQz[0]["sport"]["q1"][question].as<std::string>() == qz["quiz"]["sport"]["q1"]["question"].as<std::string>()
+		&& indexedQz["quiz"] == qz["quiz"] && diff(indexedQz, qz).empty();
+
+	//Entries taken from an indexed reader can be written out like any other
+	JSONWriter out;
+	out.add("Awkward \"Key\"", "value");
+	out.add(indexedUsers["users"][3]["firstName"]);
+	JSONReader awkward = JSONReader::createFromString(out.getString(), JSONReader::Indexed);
+	bool entries = awkward["Awkward \"Key\""].as<std::string>() == "value" && awkward["firstName"] == Users["users"][3]["firstName"];
+
+	bool missing = !indexedUsers["nobody"] && !indexedUsers["users"][5] && !indexedArray[5] && !indexedArray["users"]
+		&& !JSONReader::createFromString("{ \"unfinished\": [1, 2 }", JSONReader::Indexed);
+
+	return quiz && entries && missing;
+}
+
+bool indexedMemory() {
+	JSONWriter out;
+	out.startArray("users");
+	for (int i = 0; i < 10000; ++i) {
+		out.startArrayItem();
+		out.add("userId", i);
+		out.add("firstName", "Krish");
+		out.add("lastName", "Lee");
+		out.add("phoneNumber", "123456");
+		out.add("emailAddress", "krish.lee@learningcontainer.com");
+		out.endArrayItem();
+	}
+	out.endArray();
+	std::string data = out.getString();
+
+	//The default mode holds the text of the document, where a table holds only its values, without keys or whitespace
+	std::string source = data;
+	JSONNodeTable table(source);
+	bool smaller = table.valid() && source.empty() && table.memoryUsage() < data.length();
+
+	//Nothing is lost in keeping it that way
+	JSONReader rebuilt = JSONReader::createFromString("{" + table.text(JSONNodeTable::root()) + "}");
+	return smaller && rebuilt["users"] == JSONReader::createFromString(data)["users"]
+		&& rebuilt["users"][9999]["userId"].as<int>() == 9999;
+}
+
+bool decodedScalars() {
+	std::string data = "{ \"count\": -42, \"ratio\": 2.5e-1, \"big\": 123456789012345678901234567890, \"flag\": true,"
+		" \"nothing\": null, \"quoted\": \"12\", \"escaped\": \"Say \\\"Hi\\\"\", \"list\": [1, 2.5, false],"
+		" \"inner\": { \"name\": \"Pickles\" } }";
+	JSONReader text = JSONReader::createFromString(data);
+	JSONReader decoded = JSONReader::createFromString(data, JSONReader::DecodeScalars);
+	if (!text || !decoded) return false;
+
+	//Decoded values should convert exactly as their text does, and both should agree on types
+	const char* keys[] = { "count", "ratio", "big", "flag", "nothing", "quoted", "escaped", "list", "inner" };
+	for (int i = 0; i < 9; ++i) {
+		JSONEntry lhs = text[std::string(keys[i])];
+		JSONEntry rhs = decoded[std::string(keys[i])];
+		//Indexed readers don't keep the whitespace between values, so objects and arrays are compared as values, not as text
+		bool sameText = (lhs.isArray() || lhs.isObject()) ? lhs == rhs : lhs.as<std::string>() == rhs.as<std::string>();
+		if (lhs.type() != rhs.type() || !sameText || lhs.as<double>() != rhs.as<double>()
+			|| lhs.as<long>() != rhs.as<long>() || lhs.as<bool>() != rhs.as<bool>()) return false;
+	}
+
+	bool types = decoded["count"].isInteger() && decoded["ratio"].type() == JSONEntry::DoubleValue && decoded["big"].isNumber()
+		&& decoded["flag"].isBool() && decoded["nothing"].isNull() && decoded["quoted"].isString() && decoded["list"].isArray()
+		&& decoded["inner"].isObject() && decoded["list"][2].isBool() && text["list"].isArray() && text["inner"].isObject()
+		&& !decoded["missing"].isNull() && decoded["missing"].type() == JSONEntry::InvalidValue;
+
+	bool values = decoded["count"].as<int>() == -42 && decoded["ratio"].as<double>() == 0.25 && decoded["flag"].as<bool>()
+		&& decoded["quoted"].as<int>() == 12 && decoded["escaped"].as<std::string>() == "Say \"Hi\""
+		&& decoded["list"][1].as<float>() == 2.5f && decoded["inner"]["name"].as<std::string>() == "Pickles";
+
+	return types && values;
+}
+
+bool strictValidation() {
+	std::ifstream in("Users.json");
+	std::stringstream users;
+	users << in.rdbuf();
+	if (!JSONValidator(users.str()) || !JSONValidator("[1, -0.5e+3, \"caf\xc3\xa9 \\u00e9\", true, null, {}]") || !JSONValidator(" 42 ")) return false;
+
+	//Each of these is malformed at the given offset
+	struct Case { const char* data; std::size_t offset; };
+	Case cases[] = {
+		{ "{\"a\": 1,}", 8 }, { "[01]", 2 }, { "[1.]", 3 }, { "{\"a\" 1}", 5 }, { "[\"tab\there\"]", 5 },
+		{ "[\"bad \\x escape\"]", 6 }, { "[\"overlong \xc0\xaf\"]", 11 }, { "[tru]", 1 }, { "{} {}", 3 }, { "[1, 2", 5 },
+		{ "{'single': 1}", 1 }, { "\"unterminated", 0 }
+	};
+	for (std::size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		JSONValidator check(cases[i].data);
+		if (check.valid() || check.errorOffset() != cases[i].offset || *check.error() == '\0') return false;
+	}
+
+	bool limits = !JSONValidator("[[[[1]]]]", 3) && JSONValidator("[[[1]]]", 3).valid() && !JSONValidator(users.str(), 8, 100);
+
+	//Readers which validate refuse what the others would make the best of
+	bool readers = !JSONReader::createFromString("{\"Name\": John}", JSONReader::Validate)
+		&& JSONReader::createFromString("{\"Name\": John}").valid()
+		&& JSONReader::createFromString(users.str(), JSONReader::Validate | JSONReader::Indexed)["users"][2]["firstName"].as<std::string>() == "denial";
+
+	return limits && readers;
+}
+
+bool projectionQueries() {
+	JSONReader Users("Users.json");
+	JSONReader indexedUsers("Users.json", JSONReader::Indexed);
+	JSONReader whole("UsersArray.json");
+	JSONReader qz("QuizQuestion.json");
+	if (!Users || !indexedUsers || !whole || !qz) return false;
+
+	//Every way of reading the file should give the same results as looking each one up in turn
+	JSONQuery emails("users[*].emailAddress");
+	std::vector<JSONEntry> fromText = emails.select(Users);
+	std::vector<JSONEntry> fromIndexed = emails.select(indexedUsers);
+	std::vector<std::string> fromArray = JSONQuery("[*].emailAddress").as<std::string>(whole);
+	if (fromText.size() != 5 || fromIndexed.size() != 5 || fromArray.size() != 5) return false;
+	for (int i = 0; i < 5; ++i) {
+		if (fromText[i] != Users["users"][i]["emailAddress"] || fromIndexed[i] != fromText[i]
+			|| fromArray[i] != Users["users"][i]["emailAddress"].as<std::string>()) return false;
+	}
+
+	JSONQuery names("users[?phoneNumber==\"123456\"].{ firstName, lastName, middleName }");
+	std::vector<std::string> found = names.as<std::string>(indexedUsers);
+	std::vector<JSONEntry> foundEntries = names.select(Users);
+	bool filtered = names.fieldCount() == 3 && found.size() == 6 && foundEntries.size() == 6 && found[3] == "racks"
+		&& foundEntries[4].as<std::string>() == "jacson" && !foundEntries[2];
+	std::vector<std::string> byNumber = JSONQuery("[?userId==4].lastName").as<std::string>(whole);
+	filtered = filtered && byNumber.size() == 1 && byNumber[0] == "neo";
+
+	bool single = JSONQuery("quiz.maths.q1.options[2]").as<int>(qz).at(0) == 12
+		&& JSONQuery("quiz.maths.q1.options[*]").select(qz).size() == 4 && JSONQuery("users[*].missing").select(Users).empty();
+
+	bool invalid = !JSONQuery("users[*") && !JSONQuery("users[?name=Lee]") && !JSONQuery("users.{a,b}.c") && !JSONQuery("")
+		&& JSONQuery("users[").select(Users).empty();
+
+	//The members of an object at the top level come in the order they are written, and filters only look at an element's
+	//own members, whichever way the reader was read
+	std::string mixed = "{ \"b\": {\"id\": 1, \"inner\": {\"id\": 9}}, \"a\": {\"inner\": {\"id\": 9}}, \"c\": {\"id\": 9} }";
+	bool ordered = true;
+	for (unsigned options = 0; options <= JSONReader::Indexed; options += JSONReader::Indexed) {
+		JSONReader reader = JSONReader::createFromString(mixed, options);
+		std::vector<JSONEntry> all = JSONQuery("[*]").select(reader);
+		std::vector<JSONEntry> nested = JSONQuery("[?id==9]").select(reader);
+		JSONReader rows = JSONReader::createFromString(
+			"{ \"rows\": [{\"inner\": {\"id\": 9}}, {\"id\": 9}, {\"id\": 1, \"x\": {\"id\": 9}}] }", options);
+		std::vector<JSONEntry> arrayNested = JSONQuery("rows[?id==9]").select(rows);
+		ordered = ordered && all.size() == 3 && all[0]["id"].as<int>() == 1 && all[1]["inner"]["id"].as<int>() == 9
+			&& all[2]["id"].as<int>() == 9 && nested.size() == 1 && nested[0]["id"].as<int>() == 9 && !nested[0]["inner"]
+			&& arrayNested.size() == 1 && !arrayNested[0]["x"];
+
+		//Keys and fields are also only taken from a record's own members, however deeply a member of the same name is nested
+		JSONReader records = JSONReader::createFromString("{ \"users\": [{\"profile\": {\"id\": 7, \"name\": \"Inner\"}},"
+			" {\"id\": 2, \"profile\": {\"id\": 8}}], \"meta\": {\"info\": {\"id\": 3}} }", options);
+		std::vector<JSONEntry> ids = JSONQuery("users[*].id").select(records);
+		std::vector<JSONEntry> fields = JSONQuery("users[*].{id, name}").select(records);
+		ordered = ordered && ids.size() == 1 && ids[0].as<int>() == 2 && fields.size() == 4 && !fields[0] && !fields[1]
+			&& fields[2].as<int>() == 2 && !fields[3] && JSONQuery("meta.id").select(records).empty()
+			&& JSONQuery("meta.info.id").as<int>(records).at(0) == 3 && JSONQuery("users[0].profile.id").as<int>(records).at(0) == 7;
+	}
+
+	return filtered && single && invalid && ordered;
+}
+
+bool staticReaderWriter() {
+	std::ifstream in("Users.json");
+	std::stringstream users;
+	users << in.rdbuf();
+	JSONReader Users("Users.json");
+	JSONReader qz("QuizQuestion.json");
+	StaticJSONReader<4096, 128> staticUsers(users.str());
+	if (!Users || !qz || !staticUsers) return false;
+
+	//The fixed-size reader should give the same answers as the usual one
+	for (int i = 0; i < 5; ++i) {
+		if (staticUsers["users"][i]["emailAddress"].as<std::string>() != Users["users"][i]["emailAddress"].as<std::string>()
+			|| staticUsers["users"][i]["userId"].as<int>() != Users["users"][i]["userId"].as<int>()) return false;
+	}
+	std::string quizText = "{\"quiz\": {\"maths\": {\"q1\": {\"options\": [\"10\", \"11\", \"12\"], \"answer\": \"12\"}},"
+		" \"a \\\"quoted\\\" \\u00e9\": 2.5, \"flag\": true}}";
+	StaticJSONReader<256, 16> quiz(quizText);
+	char answer[8];
+	bool reading = quiz["quiz"]["maths"]["q1"]["options"][2].as<int>() == qz["quiz"]["maths"]["q1"]["options"][2].as<int>()
+		&& quiz["quiz"]["a \"quoted\" \xc3\xa9"].as<double>() == 2.5 && quiz["quiz"]["\"a \\\"quoted\\\" \\u00e9\""].isNumber()
+		&& quiz["quiz"]["flag"].as<bool>() && quiz["quiz"]["maths"].isObject() && quiz["quiz"]["maths"]["q1"]["options"].isArray()
+		&& quiz["quiz"]["maths"]["q1"]["answer"].copyString(answer, sizeof(answer)) == 2 && std::string(answer, 2) == "12"
+		&& staticUsers["users"]["lastName"].as<std::string>() == "Lee" && !quiz["nothing"] && !quiz["quiz"]["maths"]["q2"]
+		&& quiz["nothing"].as<std::string>() == "N/A";
+
+	//Data too large for the reader is told apart from data which is malformed
+	StaticJSONReader<64, 128> tooLong(users.str());
+	StaticJSONReader<4096, 16> tooMany(users.str());
+	StaticJSONReader<64, 16> malformed("{ \"unfinished\": [1, 2 }");
+	bool limits = !tooLong && tooLong.overflowed() && !tooMany && tooMany.overflowed() && !malformed && !malformed.overflowed();
+
+	//The fixed-size writer should write exactly what JSONWriter does
+	std::vector<int> codes;
+	codes.push_back(7);
+	codes.push_back(8);
+	JSONWriter expected;
+	StaticJSONWriter<512> out;
+	expected.add("Name", "The \"Doctor\"");
+	out.add("Name", "The \"Doctor\"");
+	expected.add("Age", 1200);
+	out.add("Age", 1200);
+	expected.startArray("Aliases");
+	out.startArray("Aliases");
+	expected.addSimpleArrayItem("John Smith");
+	out.addSimpleArrayItem("John Smith");
+	expected.addSimpleArrayItem(2.5);
+	out.addSimpleArrayItem(2.5);
+	expected.endArray();
+	out.endArray();
+	expected.startArray("users");
+	out.startArray("users");
+	for (int i = 0; i < 2; ++i) {
+		expected.startArrayItem();
+		out.startArrayItem();
+		expected.add("userId", i);
+		out.add("userId", i);
+		expected.add("codes", codes);
+		out.add("codes", codes);
+		expected.endArrayItem();
+		out.endArrayItem();
+	}
+	expected.endArray();
+	out.endArray();
+	expected.add("Fugitive", true);
+	out.add("Fugitive", true);
+	expected.add(Users["users"][1]["firstName"]);
+	out.add(staticUsers["users"][1]["firstName"]);
+	bool writing = out.valid() && out.getString() == expected.getString() && out.getString(true) == expected.getString(true)
+		&& std::string(out.c_str(), out.length()) == expected.getString() && StaticJSONWriter<16>().getString() == JSONWriter().getString();
+
+	StaticJSONWriter<32> full;
+	full.add("Name", "The Doctor");
+	full.add("Planet of Origin", "Gallifrey");
+	full.add("Age", 1200);
+	bool overflow = !full && full.overflowed() && *full.c_str() == '\0';
+
+	return reading && limits && writing && overflow;
+}
+
+bool shapePrediction() {
+	JSONReader Users("Users.json");
+	JSONReader indexedUsers("Users.json", JSONReader::Indexed);
+	if (!Users || !indexedUsers) return false;
+
+	//Every user has the same keys, so at least after the first each lookup should find its member where the last one was
+	JSONEntry::resetLookupStats();
+	for (int i = 0; i < 5; ++i) {
+		if (indexedUsers["users"][i]["lastName"] != Users["users"][i]["lastName"]) return false;
+	}
+	JSONEntry::LookupStats stats = JSONEntry::lookupStats();
+#ifdef JSON_03_THREAD_LOCAL
+	bool predicted = stats.hits >= 4 && stats.hits + stats.misses == 5 && stats.hitRate() >= 0.8;
+#else
+	bool predicted = stats.hits == 0 && stats.misses == 0;
+#endif
+
+	//Predictions which no longer hold - objects of another shape, another reader, or the same array holding another key - must
+	//still find the right member
+	JSONReader mixed = JSONReader::createFromString("{ \"rows\": [{\"a\": 1, \"b\": 2}, {\"b\": 3, \"a\": 4}, {\"a\": 5, \"b\": 6}] }",
+		JSONReader::Indexed);
+	JSONReader other = JSONReader::createFromString("{ \"rows\": [{\"b\": 7, \"a\": 8}] }", JSONReader::Indexed);
+	bool correct = true;
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int i = 0; i < 3; ++i) {
+			correct = correct && mixed["rows"][i]["a"].as<int>() == (i == 1 ? 4 : 1 + 2 * i);
+		}
+		correct = correct && other["rows"][0]["a"].as<int>() == 8;
+	}
+	char key[2] = "a";
+	correct = correct && mixed["rows"][0][key].as<int>() == 1;
+	key[0] = 'b';
+	correct = correct && mixed["rows"][0][key].as<int>() == 2 && !mixed["rows"][0]["c"];
+
+	return predicted && correct;
+}
+
+bool splicedSubtrees() {
+	JSONReader Users("Users.json");
+	JSONReader indexedUsers("Users.json", JSONReader::Indexed);
+	if (!Users || !indexedUsers) return false;
+
+	//Spliced entries are written exactly as added ones are, and text entries are simply added
+	JSONWriter added;
+	JSONWriter spliced;
+	JSONWriter splicedText;
+	added.startArray("users");
+	spliced.startArray("users");
+	splicedText.startArray("users");
+	for (int i = 0; i < 5; ++i) {
+		added.startArrayItem();
+		spliced.startArrayItem();
+		splicedText.startArrayItem();
+		added.add(indexedUsers["users"][i]["firstName"]);
+		spliced.splice(indexedUsers["users"][i]["firstName"]);
+		splicedText.splice(Users["users"][i]["firstName"]);
+		added.add(indexedUsers["users"][i]["userId"]);
+		spliced.splice(indexedUsers["users"][i]["userId"]);
+		splicedText.splice(Users["users"][i]["userId"]);
+		added.endArrayItem();
+		spliced.endArrayItem();
+		splicedText.endArrayItem();
+	}
+	added.endArray();
+	spliced.endArray();
+	splicedText.endArray();
+	bool verbatim = spliced.getString() == added.getString()
+		&& JSONReader::createFromString(splicedText.getString())["users"] == JSONReader::createFromString(added.getString())["users"]
+		&& spliced["users/3/firstName"].as<std::string>() == "devid";
+
+	//The reader's data outlives the reader, for as long as the writer needs it
+	JSONWriter forwarded;
+	{
+		JSONReader scoped("Users.json", JSONReader::Indexed);
+		JSONReader quiz("QuizQuestion.json", JSONReader::Indexed);
+		forwarded.splice(scoped["users"], JSONWriter::Minified);
+		forwarded.startArray("first");
+		forwarded.startArrayItem();
+		forwarded.splice(scoped["users"][0], JSONWriter::Reindented);
+		forwarded.endArrayItem();
+		forwarded.endArray();
+		forwarded.startArray("answers");
+		forwarded.splice(quiz["quiz"]["maths"]["q1"]["options"][0]);
+		forwarded.addSimpleArrayItem(6);
+		forwarded.endArray();
+		forwarded.splice(scoped["users"][1]["lastName"], JSONWriter::Reindented);
+	}
+	std::string text = forwarded.getString();
+	JSONReader in = JSONReader::createFromString(text);
+	bool reformatted = in["users"] == Users["users"] && in["lastName"].as<std::string>() == "jacson"
+		&& text.find("\"users\":[{\"userId\":1,\"firstName\":\"Krish\",") != std::string::npos
+		&& text.find("\"first\":[\n\t{\n\t\t\"userId\":1,\n\t\t\"firstName\":\"Krish\",") != std::string::npos
+		&& in["first"][0]["emailAddress"] == Users["users"][0]["emailAddress"] && in["answers"][0].as<int>() == 10
+		&& in["answers"][1].as<int>() == 6;
+
+	//Changing a spliced value leaves the reader's data alone
+	bool replaced = forwarded.replace("lastName", "Smith") && JSONReader::createFromString(forwarded.getString())["lastName"].as<std::string>() == "Smith"
+		&& indexedUsers["users"][1]["lastName"].as<std::string>() == "jacson";
+
+	return verbatim && reformatted && replaced;
+}
+
 std::string getPassFail(bool b) {
 	if (b) return "\t\tPASSED\n";
 	else return "\t\tFAILED\n";
@@ -153,6 +828,22 @@ int main() {
 	std::cout << "Copying file contents: " << getPassFail(copyUsers());
 	std::cout << "Testing creation from string:" << getPassFail(matchFromString());
 	std::cout << "Testing mixed access types: " << getPassFail(testAccessSpecifier());
+	std::cout << "Escaping and unescaping strings: " << getPassFail(escapeRoundTrip());
+	std::cout << "Reading unnamed arrays: " << getPassFail(rootArrayCheck());
+	std::cout << "Concurrent lookups: " << getPassFail(concurrentLookups());
+	std::cout << "Parallel array segments: " << getPassFail(parallelSegments());
+	std::cout << "Asynchronous file IO: " << getPassFail(asyncFileIO());
+	std::cout << "Diffing snapshots: " << getPassFail(snapshotDiff());
+	std::cout << "Writer lookup by path: " << getPassFail(writerPaths());
+	std::cout << "Writing whole containers: " << getPassFail(containerSerialisation());
+	std::cout << "Indexed reading: " << getPassFail(indexedReader());
+	std::cout << "Indexed memory use: " << getPassFail(indexedMemory());
+	std::cout << "Decoded scalars: " << getPassFail(decodedScalars());
+	std::cout << "Strict validation: " << getPassFail(strictValidation());
+	std::cout << "Projection queries: " << getPassFail(projectionQueries());
+	std::cout << "Heap-free reader and writer: " << getPassFail(staticReaderWriter());
+	std::cout << "Predicted key lookups: " << getPassFail(shapePrediction());
+	std::cout << "Splicing reader subtrees: " << getPassFail(splicedSubtrees());
 
 
 